@@ -0,0 +1,138 @@
+#ifndef RAYTRACER_AABB_H
+#define RAYTRACER_AABB_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "Interval.h"
+#include "Ray.h"
+#include "Vector3.h"
+
+// Axis-aligned bounding box, used by the acceleration structures to skip whole groups of objects
+class AABB {
+public:
+    AABB() = default;
+    AABB(const Point3& minimum, const Point3& maximum) : min_(minimum), max_(maximum) {}
+
+    const Point3& min() const { return min_; }
+    const Point3& max() const { return max_; }
+
+    Point3 centroid() const { return 0.5 * (min_ + max_); }
+    Vector3 extent() const { return max_ - min_; }
+
+    bool isEmpty() const { return min_.x() > max_.x() || min_.y() > max_.y() || min_.z() > max_.z(); }
+
+    // 0 = x, 1 = y, 2 = z
+    int longestAxis() const {
+        Vector3 e = extent();
+        if (e.x() > e.y() && e.x() > e.z()) return 0;
+        return e.y() > e.z() ? 1 : 2;
+    }
+
+    double surfaceArea() const {
+        if (isEmpty()) return 0.0;
+        Vector3 e = extent();
+        return 2.0 * (e.x() * e.y() + e.y() * e.z() + e.z() * e.x());
+    }
+
+    void expand(const Point3& p) {
+        min_ = Point3(std::min(min_.x(), p.x()), std::min(min_.y(), p.y()), std::min(min_.z(), p.z()));
+        max_ = Point3(std::max(max_.x(), p.x()), std::max(max_.y(), p.y()), std::max(max_.z(), p.z()));
+    }
+
+    void expand(const AABB& other) {
+        if (other.isEmpty()) return;
+        expand(other.min_);
+        expand(other.max_);
+    }
+
+    static AABB surrounding(const AABB& a, const AABB& b) {
+        AABB result = a;
+        result.expand(b);
+        return result;
+    }
+
+    // Slab test, returns the parametric range the ray spends inside the box
+    std::optional<Interval> rayOverlap(const Ray& ray, Interval rayInterval) const {
+        double tMin = rayInterval.min();
+        double tMax = rayInterval.max();
+        Point3 origin = ray.origin();
+        Vector3 direction = ray.direction();
+
+        const double origins[3] = { origin.x(), origin.y(), origin.z() };
+        const double directions[3] = { direction.x(), direction.y(), direction.z() };
+        const double minimums[3] = { min_.x(), min_.y(), min_.z() };
+        const double maximums[3] = { max_.x(), max_.y(), max_.z() };
+
+        for (int axis = 0; axis < 3; ++axis) {
+            double inverse = 1.0 / directions[axis];
+            double t0 = (minimums[axis] - origins[axis]) * inverse;
+            double t1 = (maximums[axis] - origins[axis]) * inverse;
+            if (inverse < 0.0) std::swap(t0, t1);
+
+            tMin = t0 > tMin ? t0 : tMin;
+            tMax = t1 < tMax ? t1 : tMax;
+            if (tMax < tMin) return std::nullopt;
+        }
+
+        return Interval(tMin, tMax);
+    }
+
+    bool rayHit(const Ray& ray, Interval rayInterval) const {
+        return rayOverlap(ray, rayInterval).has_value();
+    }
+
+private:
+    Point3 min_{ +infinity, +infinity, +infinity };
+    Point3 max_{ -infinity, -infinity, -infinity };
+};
+
+
+// Flat bounding volume hierarchy builder shared by InstanceGroup and LightBVH.
+// Median split on the longest centroid axis, so the depth stays logarithmic. Items are reordered so every
+// leaf owns the contiguous range [first, first + count); the root is nodes[0] and the two children of an
+// interior node (count 0) sit next to each other at first and first + 1.
+// Node needs bounds, first and count members, boundsOf(item) returns the item's AABB.
+template <typename Node, typename Item, typename BoundsOf>
+void buildMedianSplitTree(std::vector<Node>& nodes, std::vector<Item>& items, uint32_t maximumLeafSize, const BoundsOf& boundsOf) {
+    nodes.clear();
+    if (items.empty()) return;
+    nodes.reserve(2 * items.size());
+    nodes.push_back(Node{});
+
+    auto buildNode = [&](auto& self, uint32_t nodeIndex, uint32_t begin, uint32_t end) -> void {
+        AABB nodeBounds;
+        AABB centroidBounds;
+        for (uint32_t i = begin; i < end; ++i) {
+            AABB itemBounds = boundsOf(items[i]);
+            nodeBounds.expand(itemBounds);
+            centroidBounds.expand(itemBounds.centroid());
+        }
+        nodes[nodeIndex].bounds = nodeBounds;
+
+        uint32_t count = end - begin;
+        if (count <= maximumLeafSize) {
+            nodes[nodeIndex].first = begin;
+            nodes[nodeIndex].count = count;
+            return;
+        }
+
+        int axis = centroidBounds.longestAxis();
+        auto axisValue = [axis](const Point3& p) { return axis == 0 ? p.x() : (axis == 1 ? p.y() : p.z()); };
+        uint32_t middle = begin + count / 2;
+        std::nth_element(items.begin() + begin, items.begin() + middle, items.begin() + end,
+            [&](const Item& a, const Item& b) { return axisValue(boundsOf(a).centroid()) < axisValue(boundsOf(b).centroid()); });
+
+        uint32_t leftChild = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(Node{});
+        nodes.push_back(Node{});
+        nodes[nodeIndex].first = leftChild;
+        nodes[nodeIndex].count = 0;
+
+        self(self, leftChild, begin, middle);
+        self(self, leftChild + 1, middle, end);
+    };
+    buildNode(buildNode, 0, 0, static_cast<uint32_t>(items.size()));
+}
+
+#endif //RAYTRACER_AABB_H
@@ -35,6 +35,11 @@ public:
         return Ray(lookfrom, lowerLeftCorner + u * horizontal + v * vertical - lookfrom);
     }
 
+    // Angle covered by one pixel row, used to estimate ray footprints for texture filtering
+    double pixelSpreadAngle() const {
+        return vertical.length() / imageHeight;   // focal length is 1
+    }
+
     void updateCamera() {
         Vector3 forward = unitVector(lookat - lookfrom); // View direction
         Vector3 worldUp(0, 1, 0);
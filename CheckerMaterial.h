@@ -12,6 +12,24 @@ public:
     }
 
     virtual Color3 shade(const Ray& ray, const HitRecord& rec) const override {
+        Vector3 lightDir = Vector3(1, 1, -1).unitVector();
+        float diffuse = std::max(0.0, rec.surfaceNormal_.dot(lightDir));
+
+        return diffuse * albedo(rec);
+    }
+
+    // Lit by the scene's lights when it has any
+    virtual Color3 shade(const Ray& ray, const HitRecord& rec, const Scene& scene, bool shadows = true, int lightSamples = 1) const override {
+        if (!scene.hasLights()) return shade(ray, rec);
+
+        return albedo(rec) * scene.diffuseLighting(rec.hitPoint_, rec.surfaceNormal_, lightSamples, shadows);
+    }
+
+private:
+    Color3 color1_, color2_;
+    double scale_;
+
+    Color3 albedo(const HitRecord& rec) const {
         double s = scale_;
         double x = rec.hitPoint_.x();
         double y = rec.hitPoint_.y();
@@ -20,15 +38,8 @@ public:
         int check = static_cast<int>(std::floor(x * s) + std::floor(y * s) + std::floor(z * s));
         bool useFirst = (check % 2) == 0;
 
-        Vector3 lightDir = Vector3(1, 1, -1).unitVector();
-        float diffuse = std::max(0.0, rec.surfaceNormal_.dot(lightDir));
-
-        return diffuse * (useFirst ? color1_ : color2_);
+        return useFirst ? color1_ : color2_;
     }
-
-private:
-    Color3 color1_, color2_;
-    double scale_;
 };
 
 #endif // RAYTRACER_CHECKERMATERIAL_H
\ No newline at end of file
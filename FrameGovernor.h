@@ -0,0 +1,109 @@
+#ifndef RAYTRACER_FRAMEGOVERNOR_H
+#define RAYTRACER_FRAMEGOVERNOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+
+// Internal resolution + sample count picked for one frame
+struct FrameScale {
+    double scale{ 1.0 };        // fraction of the output width/height actually traced
+    int samplesPerPixel{ 4 };
+    int width{ 0 };
+    int height{ 0 };
+    bool fullResolution{ true };
+};
+
+// Keeps interactive frames inside a fixed frame-time budget.
+// While the camera is moving we trace a smaller image (and fewer samples) and upscale it,
+// the size being derived from the measured cost of the previous frames.
+// Once input stops the caller asks for fullFrame() and gets the regular quality back.
+class FrameGovernor {
+public:
+    FrameGovernor(int outputWidth, int outputHeight, double budgetMs = 16.0, int fullSamplesPerPixel = 4)
+        : outputWidth_(outputWidth), outputHeight_(outputHeight),
+          budgetMs_(budgetMs), fullSamplesPerPixel_(fullSamplesPerPixel) {
+    }
+
+    double budgetMs() const { return budgetMs_; }
+    void setBudgetMs(double budgetMs) { budgetMs_ = std::max(1.0, budgetMs); }
+
+    // Scale to use for the next frame while the camera is in motion
+    FrameScale interactiveFrame() const {
+        FrameScale frame;
+        frame.samplesPerPixel = 1;   // drop anti-aliasing first, it is the cheapest quality to lose while moving
+        frame.fullResolution = false;
+
+        if (costPerSampleMs_ <= 0.0) {
+            // Nothing measured yet, start conservatively
+            frame.scale = 0.25;
+        }
+        else {
+            // samples we can afford = budget / cost, spread over the image area
+            double affordableSamples = budgetMs_ / costPerSampleMs_;
+            double fullSamples = double(outputWidth_) * outputHeight_ * frame.samplesPerPixel;
+            frame.scale = std::sqrt(affordableSamples / fullSamples);
+        }
+
+        // Quantize to 1/16 steps so the size doesn't flicker from frame to frame
+        frame.scale = std::floor(frame.scale * 16.0) / 16.0;
+        frame.scale = std::clamp(frame.scale, minimumScale_, 1.0);
+
+        return sized(frame);
+    }
+
+    // Regular quality frame, used once input has stopped
+    FrameScale fullFrame() const {
+        FrameScale frame;
+        frame.scale = 1.0;
+        frame.samplesPerPixel = fullSamplesPerPixel_;
+        frame.fullResolution = true;
+        return sized(frame);
+    }
+
+    // Feed back how long a frame took so the next one can be sized
+    void recordFrame(const FrameScale& frame, double elapsedMs) {
+        double samples = double(frame.width) * frame.height * frame.samplesPerPixel;
+        if (samples <= 0.0) return;
+
+        double cost = elapsedMs / samples;
+        // Exponential moving average, keeps a single hiccup from collapsing the resolution
+        costPerSampleMs_ = (costPerSampleMs_ <= 0.0) ? cost : 0.7 * costPerSampleMs_ + 0.3 * cost;
+
+        std::cout << "Frame " << frame.width << "x" << frame.height
+                  << " (scale " << frame.scale << ", spp " << frame.samplesPerPixel << ") "
+                  << elapsedMs << " ms / " << budgetMs_ << " ms budget"
+                  << (frame.fullResolution ? " [full]" : "") << "\n";
+    }
+
+private:
+    int outputWidth_;
+    int outputHeight_;
+    double budgetMs_;
+    int fullSamplesPerPixel_;
+    double minimumScale_{ 0.125 };
+    double costPerSampleMs_{ 0.0 };   // smoothed cost of one camera sample
+
+    FrameScale sized(FrameScale frame) const {
+        frame.width = std::max(1, static_cast<int>(outputWidth_ * frame.scale));
+        frame.height = std::max(1, static_cast<int>(outputHeight_ * frame.scale));
+        return frame;
+    }
+};
+
+// Nearest-neighbour upscale of a reduced internal frame into the output buffer
+inline void upscaleNearest(const uint32_t* source, int sourceWidth, int sourceHeight,
+                           uint32_t* destination, int destinationWidth, int destinationHeight) {
+    for (int y = 0; y < destinationHeight; ++y) {
+        int sy = y * sourceHeight / destinationHeight;
+        const uint32_t* sourceRow = source + sy * sourceWidth;
+        uint32_t* destinationRow = destination + y * destinationWidth;
+
+        for (int x = 0; x < destinationWidth; ++x) {
+            destinationRow[x] = sourceRow[x * sourceWidth / destinationWidth];
+        }
+    }
+}
+
+#endif //RAYTRACER_FRAMEGOVERNOR_H
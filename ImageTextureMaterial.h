@@ -0,0 +1,55 @@
+#ifndef RAYTRACER_IMAGETEXTUREMATERIAL_H
+#define RAYTRACER_IMAGETEXTUREMATERIAL_H
+
+
+#include <cmath>
+#include "Scene.h"
+#include "Material.h"
+#include "TextureCache.h"
+
+// Image texture planar-mapped onto the XZ plane (same projection as the checker floor),
+// looked up through a shared TextureCache. The ray footprint picks the mip level, so
+// distant hits only pull in small, coarse tiles.
+class ImageTextureMaterial : public Material {
+public:
+    // scale = texture repeats per world unit, pixelSpreadAngle = angle covered by one camera pixel
+    ImageTextureMaterial(TextureCache& cache, int textureId, double scale, double pixelSpreadAngle)
+        : cache_(cache), textureId_(textureId), scale_(scale), pixelSpreadAngle_(pixelSpreadAngle) {
+    }
+
+    virtual Color3 shade(const Ray& ray, const HitRecord& rec) const override {
+        Vector3 lightDir = Vector3(1, 1, -1).unitVector();
+        float diffuse = std::max(0.0, rec.surfaceNormal_.dot(lightDir));
+
+        return diffuse * albedo(ray, rec);
+    }
+
+    // Lit by the scene's lights when it has any
+    virtual Color3 shade(const Ray& ray, const HitRecord& rec, const Scene& scene, bool shadows = true, int lightSamples = 1) const override {
+        if (!scene.hasLights()) return shade(ray, rec);
+
+        return albedo(ray, rec) * scene.diffuseLighting(rec.hitPoint_, rec.surfaceNormal_, lightSamples, shadows);
+    }
+
+private:
+    TextureCache& cache_;
+    int textureId_;
+    double scale_;
+    double pixelSpreadAngle_;
+
+    Color3 albedo(const Ray& ray, const HitRecord& rec) const {
+        double u = rec.hitPoint_.x() * scale_;
+        double v = rec.hitPoint_.z() * scale_;
+
+        // Width of the pixel cone where it lands, stretched at grazing angles
+        double rayLength = ray.direction().length();
+        double distance = rec.distanceAlongRay_ * rayLength;
+        double cosine = std::abs(rec.surfaceNormal_.dot(ray.direction())) / rayLength;
+        double footprintWorld = distance * pixelSpreadAngle_ / std::max(cosine, 0.05);
+        double footprintTexels = footprintWorld * scale_ * cache_.width(textureId_);
+
+        return cache_.sample(textureId_, u, v, footprintTexels);
+    }
+};
+
+#endif // RAYTRACER_IMAGETEXTUREMATERIAL_H
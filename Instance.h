@@ -0,0 +1,164 @@
+#ifndef RAYTRACER_INSTANCE_H
+#define RAYTRACER_INSTANCE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "AABB.h"
+#include "Scene.h"
+#include "Transform.h"
+
+// Places shared geometry (a primitive or a whole sub-Scene) in the world through an affine transform.
+// The geometry itself is not copied, so any number of instances can point at the same object.
+class Instance : public Object {
+public:
+    Instance(const Object* geometry, const Transform& objectToWorld)
+        : geometry_(geometry), objectToWorld_(objectToWorld), worldToObject_(objectToWorld.inverse()) {
+    }
+
+    std::optional<HitRecord> rayHit(const Ray& ray, Interval rayInterval) const override {
+        // Direction is left unnormalized so distances along the ray are the same in both spaces
+        Ray localRay(worldToObject_.applyToPoint(ray.origin()), worldToObject_.applyToVector(ray.direction()));
+
+        auto hit = geometry_->rayHit(localRay, rayInterval);
+        if (!hit) return std::nullopt;
+
+        hit->hitPoint_ = objectToWorld_.applyToPoint(hit->hitPoint_);
+        // Normals go through the inverse transpose; facing is preserved since d.n keeps its sign
+        hit->surfaceNormal_ = worldToObject_.applyTransposeToVector(hit->surfaceNormal_).unitVector();
+        return hit;
+    }
+
+    std::optional<AABB> boundingBox() const override {
+        auto localBounds = geometry_->boundingBox();
+        if (!localBounds) return std::nullopt;
+        return objectToWorld_.applyToBox(*localBounds);
+    }
+
+    const Object* geometry() const { return geometry_; }
+    const Transform& objectToWorld() const { return objectToWorld_; }
+
+private:
+    const Object* geometry_;
+    Transform objectToWorld_;
+    Transform worldToObject_;
+};
+
+
+// Top-level structure over instances. Instances are stored by value and indexed by a flat BVH,
+// so memory is O(unique geometry + instances) instead of one heap object per copy.
+// Call build() after adding instances; until then rayHit falls back to testing every instance.
+class InstanceGroup : public Object {
+public:
+    void add(const Object* geometry, const Transform& objectToWorld) {
+        instances_.emplace_back(geometry, objectToWorld);
+        built_ = false;
+    }
+
+    void clear() {
+        instances_.clear();
+        nodes_.clear();
+        order_.clear();
+        unbounded_.clear();
+        built_ = false;
+    }
+
+    size_t size() const { return instances_.size(); }
+
+    void build() {
+        nodes_.clear();
+        order_.clear();
+        unbounded_.clear();
+        bounds_.clear();
+
+        for (uint32_t i = 0; i < instances_.size(); ++i) {
+            auto box = instances_[i].boundingBox();
+            if (box) {
+                order_.push_back(i);
+                bounds_.push_back(*box);
+            }
+            else {
+                unbounded_.push_back(i);
+                bounds_.push_back(AABB());
+            }
+        }
+
+        buildMedianSplitTree(nodes_, order_, maximumLeafSize, [this](uint32_t index) { return bounds_[index]; });
+        bounds_.clear();
+        bounds_.shrink_to_fit();
+        built_ = true;
+    }
+
+    std::optional<HitRecord> rayHit(const Ray& ray, Interval rayInterval) const override {
+        HitRecord closestHit;
+        bool hitAnything = false;
+        double closestSoFar = rayInterval.max();
+
+        auto testInstance = [&](uint32_t index) {
+            if (auto hit = instances_[index].rayHit(ray, Interval(rayInterval.min(), closestSoFar))) {
+                hitAnything = true;
+                closestSoFar = hit->distanceAlongRay();
+                closestHit = *hit;
+            }
+        };
+
+        if (!built_) {
+            for (uint32_t i = 0; i < instances_.size(); ++i) testInstance(i);
+            return hitAnything ? std::optional<HitRecord>{closestHit} : std::nullopt;
+        }
+
+        for (uint32_t index : unbounded_) testInstance(index);
+
+        if (!nodes_.empty()) {
+            uint32_t stack[64];
+            int stackSize = 0;
+            stack[stackSize++] = 0;
+
+            while (stackSize > 0) {
+                const Node& node = nodes_[stack[--stackSize]];
+                if (!node.bounds.rayHit(ray, Interval(rayInterval.min(), closestSoFar))) continue;
+
+                if (node.count > 0) {
+                    for (uint32_t i = node.first; i < node.first + node.count; ++i) testInstance(order_[i]);
+                }
+                else {
+                    stack[stackSize++] = node.first;       // left child
+                    stack[stackSize++] = node.first + 1;   // right child
+                }
+            }
+        }
+
+        return hitAnything ? std::optional<HitRecord>{closestHit} : std::nullopt;
+    }
+
+    std::optional<AABB> boundingBox() const override {
+        if (!unbounded_.empty() || !built_) {
+            AABB box;
+            for (const auto& instance : instances_) {
+                auto instanceBox = instance.boundingBox();
+                if (!instanceBox) return std::nullopt;
+                box.expand(*instanceBox);
+            }
+            return box;
+        }
+        return nodes_.empty() ? AABB() : nodes_[0].bounds;
+    }
+
+private:
+    struct Node {
+        AABB bounds;
+        uint32_t first{ 0 };   // leaf: first entry in order_, interior: index of the left child (right = first + 1)
+        uint32_t count{ 0 };   // number of instances in a leaf, 0 for interior nodes
+    };
+
+    static constexpr uint32_t maximumLeafSize = 4;
+
+    std::vector<Instance> instances_;
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> order_;       // instance indices, grouped by leaf
+    std::vector<uint32_t> unbounded_;   // instances that can't go in the tree
+    std::vector<AABB> bounds_;          // per-instance world bounds, only used while building
+    bool built_{ false };
+};
+
+#endif //RAYTRACER_INSTANCE_H
@@ -0,0 +1,86 @@
+#ifndef RAYTRACER_LIGHT_H
+#define RAYTRACER_LIGHT_H
+
+#include <cmath>
+#include "AABB.h"
+#include "Color3.h"
+#include "HelperFunctions.h"
+#include "Vector3.h"
+
+// One sampled connection from a shading point to a light
+struct LightSample {
+    Vector3 direction;     // unit vector from the shading point towards the light
+    double distance;       // to the sampled point on the light
+    Color3 radiance;       // incident light at the shading point (falloff already applied)
+};
+
+
+class Light {
+public:
+    virtual ~Light() = default;
+
+    virtual LightSample sample(const Point3& from) const = 0;
+
+    // Where the light lives, used to build the light hierarchy
+    virtual AABB bounds() const = 0;
+
+    // Scalar emitted power, the hierarchy samples lights in proportion to this over distance squared
+    virtual double power() const = 0;
+};
+
+
+class PointLight : public Light {
+public:
+    PointLight(Point3 position, Color3 intensity) : position_(position), intensity_(intensity) {}
+
+    LightSample sample(const Point3& from) const override {
+        Vector3 toLight = position_ - from;
+        double distanceSquared = toLight.length_squared();
+        double distance = std::sqrt(distanceSquared);
+        return { toLight / distance, distance, intensity_ / distanceSquared };
+    }
+
+    AABB bounds() const override { return AABB(position_, position_); }
+
+    double power() const override { return luminance(intensity_); }
+
+    static double luminance(const Color3& c) { return 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z(); }
+
+private:
+    Point3 position_;
+    Color3 intensity_;
+};
+
+
+// Spherical area light, sampled at a random point on its surface (soft shadows)
+class SphereLight : public Light {
+public:
+    SphereLight(Point3 center, double radius, Color3 intensity)
+        : center_(center), radius_(radius), intensity_(intensity) {
+    }
+
+    LightSample sample(const Point3& from) const override {
+        // Uniform point on the sphere, flipped onto the half facing the shading point
+        Vector3 offset = Vector3::randomUnitVector();
+        if (offset.dot(from - center_) < 0) offset = offset * -1.0;
+
+        Vector3 toLight = (center_ + radius_ * offset) - from;
+        double distanceSquared = toLight.length_squared();
+        double distance = std::sqrt(distanceSquared);
+        return { toLight / distance, distance, intensity_ / distanceSquared };
+    }
+
+    AABB bounds() const override {
+        Vector3 r(radius_, radius_, radius_);
+        return AABB(center_ - r, center_ + r);
+    }
+
+    double power() const override { return PointLight::luminance(intensity_); }
+
+private:
+    Point3 center_;
+    double radius_;
+    Color3 intensity_;
+};
+
+#endif //RAYTRACER_LIGHT_H
@@ -0,0 +1,102 @@
+#ifndef RAYTRACER_LIGHTBVH_H
+#define RAYTRACER_LIGHTBVH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include "AABB.h"
+#include "HelperFunctions.h"
+#include "Light.h"
+
+// A light picked for a shading point, with the probability it was picked with
+struct LightChoice {
+    const Light* light;
+    double probability;
+};
+
+// Binary hierarchy over lights for many-light direct lighting.
+// Every node stores the bounds and total power of the lights below it. Sampling walks from the root,
+// choosing a child in proportion to its estimated contribution (power / distance squared, zero when the
+// whole node is below the surface), so one pick costs O(log n) and bright nearby lights are favoured.
+class LightBVH {
+public:
+    void build(const std::vector<const Light*>& lights) {
+        lights_ = lights;
+        buildMedianSplitTree(nodes_, lights_, 1, [](const Light* light) { return light->bounds(); });
+
+        // Children always follow their parent, so a reverse pass sums power bottom-up
+        for (size_t i = nodes_.size(); i-- > 0;) {
+            Node& node = nodes_[i];
+            node.power = node.count > 0 ? lights_[node.first]->power() : nodes_[node.first].power + nodes_[node.first + 1].power;
+        }
+    }
+
+    bool empty() const { return lights_.empty(); }
+    size_t size() const { return lights_.size(); }
+
+    std::optional<LightChoice> sample(const Point3& point, const Vector3& normal) const {
+        if (nodes_.empty()) return std::nullopt;
+
+        double probability = 1.0;
+        double u = Random::randomDouble0to1();
+        uint32_t nodeIndex = 0;
+
+        while (nodes_[nodeIndex].count == 0) {
+            const Node& node = nodes_[nodeIndex];
+            double left = importance(nodes_[node.first], point, normal);
+            double right = importance(nodes_[node.first + 1], point, normal);
+            double total = left + right;
+            if (total <= 0.0) return std::nullopt;
+
+            // Reuse u for the next level by rescaling it into the chosen side
+            double pLeft = left / total;
+            if (u < pLeft) {
+                u = u / pLeft;
+                probability *= pLeft;
+                nodeIndex = node.first;
+            }
+            else {
+                u = (u - pLeft) / (1.0 - pLeft);
+                probability *= 1.0 - pLeft;
+                nodeIndex = node.first + 1;
+            }
+            u = std::min(u, 0.99999999);
+        }
+
+        return LightChoice{ lights_[nodes_[nodeIndex].first], probability };
+    }
+
+private:
+    struct Node {
+        AABB bounds;
+        double power{ 0.0 };
+        uint32_t first{ 0 };   // leaf: index into lights_, interior: left child (right = first + 1)
+        uint32_t count{ 0 };   // 1 for leaves, 0 for interior nodes
+    };
+
+    std::vector<const Light*> lights_;
+    std::vector<Node> nodes_;
+
+    static double importance(const Node& node, const Point3& point, const Vector3& normal) {
+        if (node.power <= 0.0) return 0.0;
+
+        // Skip nodes entirely behind the surface
+        const AABB& b = node.bounds;
+        bool anyInFront = false;
+        for (int corner = 0; corner < 8 && !anyInFront; ++corner) {
+            Point3 c((corner & 1) ? b.max().x() : b.min().x(),
+                     (corner & 2) ? b.max().y() : b.min().y(),
+                     (corner & 4) ? b.max().z() : b.min().z());
+            anyInFront = (c - point).dot(normal) > 0.0;
+        }
+        if (!anyInFront) return 0.0;
+
+        // Distance to the centre, clamped by the node size so clusters around the point aren't overweighted
+        double distanceSquared = (b.centroid() - point).length_squared();
+        double halfDiagonalSquared = 0.25 * b.extent().length_squared();
+        return node.power / std::max(distanceSquared, std::max(halfDiagonalSquared, 1e-4));
+    }
+};
+
+#endif //RAYTRACER_LIGHTBVH_H
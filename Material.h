@@ -17,8 +17,9 @@ public:
         return Color3(0, 0, 0); // Default implementation
     }
 
-    // Optional override: for materials that need access to the scene (e.g. reflection)
-    virtual Color3 shade(const Ray& ray, const HitRecord& rec, const Scene& scene) const {
+    // Optional override: for materials that need access to the scene (e.g. reflection).
+    // shadows = false skips shadow rays towards the scene's lights, lightSamples is the number of lights picked.
+    virtual Color3 shade(const Ray& ray, const HitRecord& rec, const Scene& scene, bool shadows = true, int lightSamples = 1) const {
         return shade(ray, rec); // Fallback to simpler version
     }
 };
@@ -0,0 +1,67 @@
+#ifndef RAYTRACER_RAYREORDER_H
+#define RAYTRACER_RAYREORDER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "AABB.h"
+#include "Color3.h"
+#include "HelperFunctions.h"
+#include "Ray.h"
+
+// A ray spawned at a hit (reflection, shadow, ...) waiting to be traced as part of a batch
+struct SecondaryRay {
+    Ray ray;
+    Color3 weight;          // contribution of whatever this ray finds to the pixel
+    uint32_t pixelIndex;
+    double maxDistance{ infinity };   // shadow rays: distance to the light, anything past it doesn't block
+    uint64_t sortKey{ 0 };
+};
+
+// Spreads the low 10 bits of v so there are two zero bits between each
+inline uint32_t expandBits10(uint32_t v) {
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+// 30 bit Morton code of a point given in [0, 1]^3
+inline uint32_t mortonCode3D(double x, double y, double z) {
+    auto quantize = [](double value) {
+        return static_cast<uint32_t>(std::clamp(value * 1024.0, 0.0, 1023.0));
+    };
+    return (expandBits10(quantize(x)) << 2) | (expandBits10(quantize(y)) << 1) | expandBits10(quantize(z));
+}
+
+// Sign bits of the direction, rays in the same octant visit boxes in the same order
+inline uint32_t directionOctant(const Vector3& direction) {
+    return (direction.x() < 0 ? 1u : 0u) | (direction.y() < 0 ? 2u : 0u) | (direction.z() < 0 ? 4u : 0u);
+}
+
+// Reorders a batch so neighbouring rays start close together and point the same way:
+// key = direction octant (high bits) then Morton code of the origin inside the batch bounds.
+// Tracing in that order keeps the same objects and tree nodes hot in cache.
+inline void sortRaysForCoherence(std::vector<SecondaryRay>& rays) {
+    if (rays.size() < 2) return;
+
+    AABB originBounds;
+    for (const auto& r : rays) originBounds.expand(r.ray.origin());
+
+    Vector3 extent = originBounds.extent();
+    auto inverseExtent = [](double e) { return e > 0.0 ? 1.0 / e : 0.0; };
+    double ix = inverseExtent(extent.x()), iy = inverseExtent(extent.y()), iz = inverseExtent(extent.z());
+
+    for (auto& r : rays) {
+        Vector3 local = r.ray.origin() - originBounds.min();
+        uint32_t morton = mortonCode3D(local.x() * ix, local.y() * iy, local.z() * iz);
+        r.sortKey = (uint64_t(directionOctant(r.ray.direction())) << 30) | morton;
+    }
+
+    std::sort(rays.begin(), rays.end(),
+        [](const SecondaryRay& a, const SecondaryRay& b) { return a.sortKey < b.sortKey; });
+}
+
+#endif //RAYTRACER_RAYREORDER_H
@@ -0,0 +1,110 @@
+#ifndef RAYTRACER_RENDERPROTOCOL_H
+#define RAYTRACER_RENDERPROTOCOL_H
+
+// Wire format shared by the render server (main.cpp --server) and render_client.
+// Requests are single text lines, some followed by a binary payload:
+//
+//   LOAD <sceneId> <byteCount>\n<byteCount bytes of scene text>   ->  OK <objects> <lights>\n
+//                                                                     byteCount is at most maximumSceneBytes; a larger
+//                                                                     count gets an ERROR and the connection is closed,
+//                                                                     since the payload that follows can't be skipped
+//   RENDER <sceneId> <fromX fromY fromZ> <atX atY atZ> <yawDegrees> <width> <height> <spp>\n
+//                                                                 ->  OK <width> <height> <traceMicroseconds>\n
+//                                                                     followed by width * height ARGB8888 uint32s;
+//                                                                     width and height are 2 .. maximumImageSide,
+//                                                                     spp is 1 .. maximumSamplesPerPixel
+//   UNLOAD <sceneId>\n                                            ->  OK\n
+//   SHUTDOWN\n                                                    ->  OK\n
+//
+// Any failure is answered with "ERROR <message>\n" and the connection stays usable.
+// The server drops a connection that sends or accepts nothing for ioTimeoutSeconds.
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace RenderProtocol {
+    const size_t maximumLineLength = 4096;
+    const long long maximumSceneBytes = 16ll << 20;
+    const int maximumImageSide = 16384;
+    const int maximumSamplesPerPixel = 1024;
+    const int ioTimeoutSeconds = 30;
+
+    inline bool writeAll(int fd, const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0) {
+            ssize_t written = ::write(fd, bytes, size);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) return false;
+            bytes += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    inline bool writeLine(int fd, const std::string& line) {
+        std::string terminated = line + "\n";
+        return writeAll(fd, terminated.data(), terminated.size());
+    }
+
+    inline bool readExact(int fd, void* data, size_t size) {
+        char* bytes = static_cast<char*>(data);
+        while (size > 0) {
+            ssize_t received = ::read(fd, bytes, size);
+            if (received < 0 && errno == EINTR) continue;
+            if (received <= 0) return false;
+            bytes += received;
+            size -= static_cast<size_t>(received);
+        }
+        return true;
+    }
+
+    // Reads up to '\n' one byte at a time, so no payload bytes following the line are consumed
+    inline bool readLine(int fd, std::string& line) {
+        line.clear();
+        char c;
+        while (line.size() < maximumLineLength) {
+            if (!readExact(fd, &c, 1)) return false;
+            if (c == '\n') return true;
+            line += c;
+        }
+        return false;
+    }
+
+    // Makes blocking reads and writes on fd fail with EAGAIN after `seconds` without progress
+    inline bool setTimeouts(int fd, int seconds) {
+        timeval timeout{};
+        timeout.tv_sec = seconds;
+        return ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0
+            && ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) == 0;
+    }
+
+    inline bool fillAddress(const std::string& path, sockaddr_un& address) {
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) return false;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+
+    // Connected socket or -1
+    inline int connectTo(const std::string& path) {
+        sockaddr_un address;
+        if (!fillAddress(path, address)) return -1;
+
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+}
+
+#endif //RAYTRACER_RENDERPROTOCOL_H
@@ -0,0 +1,185 @@
+#ifndef RAYTRACER_RENDERSERVER_H
+#define RAYTRACER_RENDERSERVER_H
+
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Camera.h"
+#include "Renderer.h"
+#include "RenderProtocol.h"
+#include "SceneLoader.h"
+
+// Long-running render daemon on a local Unix socket (protocol in RenderProtocol.h).
+// Scenes are parsed, their BVH and light hierarchy built, once per LOAD and then kept by id,
+// so a RENDER request only pays for camera setup and tracing.
+// Clients are served one at a time, each connection can send any number of requests. A client that stalls
+// mid-request for RenderProtocol::ioTimeoutSeconds is disconnected so the next one can be served.
+class RenderServer {
+public:
+    explicit RenderServer(std::string socketPath) : socketPath_(std::move(socketPath)) {}
+
+    // Serves until a SHUTDOWN request, returns the process exit code
+    int run() {
+        std::signal(SIGPIPE, SIG_IGN);   // a client hanging up mid-frame must not kill the server
+
+        sockaddr_un address;
+        if (!RenderProtocol::fillAddress(socketPath_, address)) {
+            std::cerr << "RenderServer: socket path too long: " << socketPath_ << "\n";
+            return 1;
+        }
+
+        int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0) {
+            std::cerr << "RenderServer: socket() failed: " << std::strerror(errno) << "\n";
+            return 1;
+        }
+
+        ::unlink(socketPath_.c_str());   // stale socket from an earlier run
+        if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener, 8) != 0) {
+            std::cerr << "RenderServer: cannot listen on " << socketPath_ << ": " << std::strerror(errno) << "\n";
+            ::close(listener);
+            return 1;
+        }
+
+        std::cout << "Render server listening on " << socketPath_ << "\n";
+
+        while (running_) {
+            int client = ::accept(listener, nullptr, nullptr);
+            if (client < 0) {
+                if (errno == EINTR) continue;
+                std::cerr << "RenderServer: accept() failed: " << std::strerror(errno) << "\n";
+                break;
+            }
+            if (!RenderProtocol::setTimeouts(client, RenderProtocol::ioTimeoutSeconds)) {
+                std::cerr << "RenderServer: cannot set socket timeouts: " << std::strerror(errno) << "\n";
+                ::close(client);
+                continue;
+            }
+            serveClient(client);
+            ::close(client);
+        }
+
+        ::close(listener);
+        ::unlink(socketPath_.c_str());
+        std::cout << "Render server stopped\n";
+        return 0;
+    }
+
+private:
+    struct CachedScene {
+        std::unique_ptr<LoadedScene> loaded;
+        std::unique_ptr<Renderer> renderer;
+    };
+
+    std::string socketPath_;
+    std::unordered_map<std::string, CachedScene> scenes_;
+    std::vector<uint32_t> pixels_;   // reused between frames
+    bool running_{ true };
+
+    void serveClient(int client) {
+        std::string line;
+        while (running_ && RenderProtocol::readLine(client, line)) {
+            std::istringstream request(line);
+            std::string command;
+            request >> command;
+
+            bool ok;
+            if (command == "LOAD") ok = handleLoad(client, request);
+            else if (command == "RENDER") ok = handleRender(client, request);
+            else if (command == "UNLOAD") ok = handleUnload(client, request);
+            else if (command == "SHUTDOWN") {
+                running_ = false;
+                ok = RenderProtocol::writeLine(client, "OK");
+            }
+            else ok = RenderProtocol::writeLine(client, "ERROR unknown command '" + command + "'");
+
+            if (!ok) return;   // client went away
+        }
+    }
+
+    bool handleLoad(int client, std::istringstream& request) {
+        std::string sceneId;
+        long long byteCount = 0;   // signed, so "-1" is rejected instead of wrapping to a huge size
+        if (!(request >> sceneId >> byteCount) || byteCount < 0) {
+            return RenderProtocol::writeLine(client, "ERROR usage: LOAD <sceneId> <byteCount>");
+        }
+        if (byteCount > RenderProtocol::maximumSceneBytes) {
+            RenderProtocol::writeLine(client, "ERROR scene larger than " + std::to_string(RenderProtocol::maximumSceneBytes) + " bytes");
+            return false;   // the payload is on its way and can't be skipped, drop the connection
+        }
+
+        std::string text(static_cast<size_t>(byteCount), '\0');
+        if (!RenderProtocol::readExact(client, &text[0], text.size())) return false;
+
+        try {
+            auto loaded = std::make_unique<LoadedScene>();
+            std::string error;
+            if (!loaded->parse(text, error)) return RenderProtocol::writeLine(client, "ERROR " + error);
+
+            // The renderer is only bound to the scene once, the camera is replaced per frame
+            Camera placeholder(Vector3(0, 0, 0), Vector3(0, 0, -1), 1, 1.0);
+            auto renderer = std::make_unique<Renderer>(loaded->scene(), placeholder);
+            renderer->setProgressOutput(false);
+
+            std::string reply = "OK " + std::to_string(loaded->objectCount()) + " " + std::to_string(loaded->lightCount());
+            scenes_[sceneId] = CachedScene{ std::move(loaded), std::move(renderer) };
+            std::cout << "Loaded scene '" << sceneId << "'\n";
+            return RenderProtocol::writeLine(client, reply);
+        }
+        catch (const std::bad_alloc&) {
+            return RenderProtocol::writeLine(client, "ERROR out of memory while building scene '" + sceneId + "'");
+        }
+    }
+
+    bool handleRender(int client, std::istringstream& request) {
+        std::string sceneId;
+        double fx, fy, fz, ax, ay, az, yaw;
+        int width, height, samplesPerPixel;
+        if (!(request >> sceneId >> fx >> fy >> fz >> ax >> ay >> az >> yaw >> width >> height >> samplesPerPixel)) {
+            return RenderProtocol::writeLine(client, "ERROR usage: RENDER <sceneId> <from xyz> <at xyz> <yaw> <width> <height> <spp>");
+        }
+        if (width < 2 || height < 2 || width > RenderProtocol::maximumImageSide || height > RenderProtocol::maximumImageSide
+            || samplesPerPixel < 1 || samplesPerPixel > RenderProtocol::maximumSamplesPerPixel) {
+            return RenderProtocol::writeLine(client, "ERROR bad resolution or sample count");
+        }
+
+        auto found = scenes_.find(sceneId);
+        if (found == scenes_.end()) return RenderProtocol::writeLine(client, "ERROR scene '" + sceneId + "' is not loaded");
+        CachedScene& cached = found->second;
+
+        Camera camera(Vector3(fx, fy, fz), Vector3(ax, ay, az), height, double(width) / height);
+        if (yaw != 0.0) camera.rotateYaw(yaw);
+
+        try {
+            pixels_.resize(size_t(width) * height);
+        }
+        catch (const std::bad_alloc&) {
+            pixels_.clear();
+            pixels_.shrink_to_fit();
+            return RenderProtocol::writeLine(client, "ERROR out of memory for a " + std::to_string(width) + "x" + std::to_string(height) + " frame");
+        }
+        auto start = std::chrono::steady_clock::now();
+        cached.renderer->render(cached.loaded->scene(), camera, pixels_.data(), width, height, samplesPerPixel);
+        auto traceMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+        std::ostringstream reply;
+        reply << "OK " << width << " " << height << " " << traceMicroseconds;
+        return RenderProtocol::writeLine(client, reply.str())
+            && RenderProtocol::writeAll(client, pixels_.data(), pixels_.size() * sizeof(uint32_t));
+    }
+
+    bool handleUnload(int client, std::istringstream& request) {
+        std::string sceneId;
+        request >> sceneId;
+        if (scenes_.erase(sceneId) == 0) return RenderProtocol::writeLine(client, "ERROR scene '" + sceneId + "' is not loaded");
+        return RenderProtocol::writeLine(client, "OK");
+    }
+};
+
+#endif //RAYTRACER_RENDERSERVER_H
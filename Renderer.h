@@ -1,10 +1,16 @@
 #ifndef RAYTRACER_RENDERER_H
 #define RAYTRACER_RENDERER_H
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
+#include <memory>
+#include <vector>
 #include "Camera.h"
 #include "Color3.h"
+#include "RayReorder.h"
 #include "Scene.h"
+#include "ShadingBatch.h"
 
 inline float clamp(float x, float min, float max) {
     return x < min ? min : (x > max ? max : x);
@@ -16,135 +22,626 @@ inline float randomFloat() {
 
 
 
+enum class GammaMode {
+    Linear,   // write colours as they are
+    Gamma2    // sqrt, the renderer's usual output
+};
+
 class RendererParameters {
 public:
+    static constexpr int maximumReflectionDepth = 4;   // render kernels are instantiated up to this depth
+
     static RendererParameters defaultParameters() { return RendererParameters(); }
+
+    int samplesPerPixel() const { return samplesPerPixel_; }
+    bool antiAliasing() const { return antiAliasing_; }
+    bool shadows() const { return shadows_; }
+    int reflectionDepth() const { return reflectionDepth_; }
+    double reflectivity() const { return reflectivity_; }
+    bool floorPlane() const { return floorPlane_; }
+    GammaMode gammaMode() const { return gammaMode_; }
+    bool breadthFirstReflections() const { return breadthFirstReflections_; }
+    bool sortSecondaryRays() const { return sortSecondaryRays_; }
+    bool batchShadowRays() const { return batchShadowRays_; }
+    bool exactMath() const { return exactMath_; }
+
+    RendererParameters& setSamplesPerPixel(int samples) { samplesPerPixel_ = std::max(1, samples); return *this; }
+    RendererParameters& setAntiAliasing(bool enabled) { antiAliasing_ = enabled; return *this; }
+    RendererParameters& setShadows(bool enabled) { shadows_ = enabled; return *this; }
+    RendererParameters& setReflectionDepth(int depth) { reflectionDepth_ = std::clamp(depth, 0, maximumReflectionDepth); return *this; }
+    RendererParameters& setReflectivity(double reflectivity) { reflectivity_ = std::clamp(reflectivity, 0.0, 1.0); return *this; }
+    RendererParameters& setFloorPlane(bool enabled) { floorPlane_ = enabled; return *this; }
+    RendererParameters& setGammaMode(GammaMode mode) { gammaMode_ = mode; return *this; }
+    RendererParameters& setBreadthFirstReflections(bool enabled) { breadthFirstReflections_ = enabled; return *this; }
+    RendererParameters& setSortSecondaryRays(bool enabled) { sortSecondaryRays_ = enabled; return *this; }
+    RendererParameters& setBatchShadowRays(bool enabled) { batchShadowRays_ = enabled; return *this; }
+    RendererParameters& setExactMath(bool enabled) { exactMath_ = enabled; return *this; }
+
 private:
     //int imageWidth_{ 512 };
     //int imageHeight_{ 512 };
-    //int samplesPerPixel_{ 10 };
-    //int maximumRecursionDepth_{ 25 };
+    int samplesPerPixel_{ 4 };        // only used with anti-aliasing, otherwise one centred sample
+    bool antiAliasing_{ true };
+    bool shadows_{ true };            // shadow rays towards scene lights
+    int reflectionDepth_{ 0 };        // mirror bounces per camera ray
+    double reflectivity_{ 0.5 };
+    bool floorPlane_{ true };         // checkerboard floor at y = -0.5
+    GammaMode gammaMode_{ GammaMode::Gamma2 };
+    bool breadthFirstReflections_{ false };   // trace reflections one bounce level at a time in ray batches
+    bool sortSecondaryRays_{ true };          // put each batch in coherence order first
+    bool batchShadowRays_{ false };           // breadth-first: shadow rays go through the batches too
+    bool exactMath_{ false };         // scalar double shading for reference renders instead of the batched SIMD path
     //Color3 backgroundColor_{ 0.0, 0.0, 0.0 };
     //std::string fileName_{ "image.ppm" };          //not using this as i decided to use SDL2 window instead
 };
 
+// Compile-time copy of the per-frame switches in RendererParameters, one render kernel is built per combination
+template <bool AntiAliasing, bool Shadows, int ReflectionDepth, bool FloorPlane, GammaMode Gamma>
+struct RenderFeatures {
+    static constexpr bool antiAliasing = AntiAliasing;
+    static constexpr bool shadows = Shadows;
+    static constexpr int reflectionDepth = ReflectionDepth;
+    static constexpr bool floorPlane = FloorPlane;
+    static constexpr GammaMode gamma = Gamma;
+};
+
 class Renderer {
 public:
     inline Renderer(const Scene& scene, const Camera& camera)
         : camera_(camera), world_(scene) {
     }
 
+    // Replaces the inline checkerboard on the y = -0.5 floor, nullptr restores it
+    void setFloorMaterial(const Material* material) { floorMaterial_ = material; }
+
+    // Lights sampled per shading point when the scene has lights
+    void setLightSamples(int samples) { lightSamples_ = std::max(1, samples); }
+
+    // Scanline progress on stdout, on by default
+    void setProgressOutput(bool enabled) { progressOutput_ = enabled; }
+
+    void setParameters(const RendererParameters& parameters) { rendererParams_ = parameters; }
+    const RendererParameters& parameters() const { return rendererParams_; }
+
     inline void render(const Scene& scene, const Camera& camera, uint32_t* pixels, int width, int height) {
-        const int samplesPerPixel = 4;   //Anti-aliasing value, increase/decrease for more/less jaggles (beware also makes it load muuuuuch slower)
-        Vector3 lightDirection = Vector3(1, 1, -1).unitVector();
-        Color3 lightColor = Color3(1.0, 1.0, 1.0);
+        render(scene, camera, pixels, width, height, rendererParams_);
+    }
 
-        std::cout << "Starting render with anti-aliasing...\n";
+    // samplesPerPixel is the anti-aliasing value, increase/decrease for more/less jaggles (beware also makes it load muuuuuch slower)
+    inline void render(const Scene& scene, const Camera& camera, uint32_t* pixels, int width, int height, int samplesPerPixel) {
+        RendererParameters parameters = rendererParams_;
+        parameters.setSamplesPerPixel(samplesPerPixel);
+        render(scene, camera, pixels, width, height, parameters);
+    }
+
+    // Picks the kernel compiled for this feature combination once, so the per-sample loop has no feature checks
+    inline void render(const Scene& scene, const Camera& camera, uint32_t* pixels, int width, int height, const RendererParameters& parameters) {
+        Kernel kernel = selectKernel(parameters);
+        (this->*kernel)(scene, camera, pixels, width, height, parameters);
+    }
+
+private:
+    RendererParameters rendererParams_{};
+    Camera camera_;
+    Scene world_;
+    std::ofstream outFile_;
+    const Material* floorMaterial_{ nullptr };
+    int lightSamples_{ 2 };
+    bool progressOutput_{ true };
+    PhongMaterial phongMaterial_{};   // object material, shared by the exact and batched shading paths
+    std::unique_ptr<ShadingBatch> shadingBatch_{ std::make_unique<ShadingBatch>() };   // ~14 KiB, kept off the stack
+
+    using Kernel = void (Renderer::*)(const Scene&, const Camera&, uint32_t*, int, int, const RendererParameters&);
+
+    // One runtime switch per feature, each level fixing one more template argument
+    static Kernel selectKernel(const RendererParameters& parameters) {
+        return parameters.antiAliasing() ? selectShadowKernel<true>(parameters) : selectShadowKernel<false>(parameters);
+    }
+
+    template <bool AntiAliasing>
+    static Kernel selectShadowKernel(const RendererParameters& parameters) {
+        return parameters.shadows() ? selectReflectionKernel<AntiAliasing, true>(parameters)
+                                    : selectReflectionKernel<AntiAliasing, false>(parameters);
+    }
+
+    template <bool AntiAliasing, bool Shadows>
+    static Kernel selectReflectionKernel(const RendererParameters& parameters) {
+        static_assert(RendererParameters::maximumReflectionDepth == 4, "add a case for the new maximum depth");
+        switch (parameters.reflectionDepth()) {
+            case 0: return selectFloorKernel<AntiAliasing, Shadows, 0>(parameters);
+            case 1: return selectFloorKernel<AntiAliasing, Shadows, 1>(parameters);
+            case 2: return selectFloorKernel<AntiAliasing, Shadows, 2>(parameters);
+            case 3: return selectFloorKernel<AntiAliasing, Shadows, 3>(parameters);
+            default: return selectFloorKernel<AntiAliasing, Shadows, 4>(parameters);
+        }
+    }
+
+    template <bool AntiAliasing, bool Shadows, int ReflectionDepth>
+    static Kernel selectFloorKernel(const RendererParameters& parameters) {
+        return parameters.floorPlane() ? selectGammaKernel<AntiAliasing, Shadows, ReflectionDepth, true>(parameters)
+                                       : selectGammaKernel<AntiAliasing, Shadows, ReflectionDepth, false>(parameters);
+    }
+
+    template <bool AntiAliasing, bool Shadows, int ReflectionDepth, bool FloorPlane>
+    static Kernel selectGammaKernel(const RendererParameters& parameters) {
+        if (parameters.gammaMode() == GammaMode::Linear) {
+            return selectMathKernel<RenderFeatures<AntiAliasing, Shadows, ReflectionDepth, FloorPlane, GammaMode::Linear>>(parameters);
+        }
+        return selectMathKernel<RenderFeatures<AntiAliasing, Shadows, ReflectionDepth, FloorPlane, GammaMode::Gamma2>>(parameters);
+    }
+
+    template <typename Features>
+    static Kernel selectMathKernel(const RendererParameters& parameters) {
+        if constexpr (Features::reflectionDepth > 0) {
+            if (parameters.breadthFirstReflections()) {
+                // The bounce count is a runtime loop in that kernel, so all depths share one instantiation
+                using AnyDepth = RenderFeatures<Features::antiAliasing, Features::shadows, 0, Features::floorPlane, Features::gamma>;
+                return parameters.exactMath() ? &Renderer::renderReflectiveKernel<AnyDepth, true>
+                                              : &Renderer::renderReflectiveKernel<AnyDepth, false>;
+            }
+        }
+        return parameters.exactMath() ? &Renderer::renderKernel<Features> : &Renderer::renderKernelBatched<Features>;
+    }
+
+    // Camera ray through pixel (x, y): jittered with anti-aliasing, through the pixel centre without
+    template <bool AntiAliasing>
+    static Ray cameraRay(const Camera& camera, int x, int y, int width, int height) {
+        float u, v;
+        if constexpr (AntiAliasing) {
+            u = (x + randomFloat()) / (width - 1);
+            v = 1.0f - (y + randomFloat()) / (height - 1);
+        }
+        else {
+            u = (x + 0.5f) / (width - 1);
+            v = 1.0f - (y + 0.5f) / (height - 1);
+        }
+        return camera.getRay(u, v);
+    }
+
+    template <typename Features>
+    void renderKernel(const Scene& scene, const Camera& camera, uint32_t* pixels, int width, int height, const RendererParameters& parameters) {
+        const int samplesPerPixel = Features::antiAliasing ? parameters.samplesPerPixel() : 1;
+        const double reflectivity = parameters.reflectivity();
+
+        if (progressOutput_) std::cout << (Features::antiAliasing ? "Starting render with anti-aliasing...\n" : "Starting render...\n");
 
         for (int y = 0; y < height; ++y) {
-            if (y % 50 == 0) std::cout << "Scanline " << y << "/" << height << "\n"; // progress output
+            if (progressOutput_ && y % 50 == 0) std::cout << "Scanline " << y << "/" << height << "\n"; // progress output
 
             for (int x = 0; x < width; ++x) {
                 Color3 color(0, 0, 0);
 
                 for (int s = 0; s < samplesPerPixel; ++s) {
-                    float u = (x + randomFloat()) / (width - 1);
-                    float v = 1.0f - (y + randomFloat()) / (height - 1);
+                    Ray ray = cameraRay<Features::antiAliasing>(camera, x, y, width, height);
+                    color += traceColor<Features, Features::reflectionDepth>(scene, ray, reflectivity);
+                }
+
+                color /= samplesPerPixel;
+                pixels[y * width + x] = toARGB<Features::gamma>(color);
+            }
+        }
+
+        if (progressOutput_) std::cout << "Rendering complete.\n";
+    }
+
+    // Same image as renderKernel, but object hits are queued into a ShadingBatch and shaded
+    // four at a time with approximate float math; the row is then gamma-packed with SIMD as well
+    template <typename Features>
+    void renderKernelBatched(const Scene& scene, const Camera& camera, uint32_t* pixels, int width, int height, const RendererParameters& parameters) {
+        const int samplesPerPixel = Features::antiAliasing ? parameters.samplesPerPixel() : 1;
+        const float reflectivity = float(parameters.reflectivity());
+        const float sampleWeight = 1.0f / samplesPerPixel;
+
+        std::vector<float> red(width), green(width), blue(width);   // one scanline of linear colour
+        ShadingBatch& batch = *shadingBatch_;
+
+        if (progressOutput_) std::cout << (Features::antiAliasing ? "Starting render with anti-aliasing...\n" : "Starting render...\n");
 
-                    Ray ray = camera.getRay(u, v);
+        for (int y = 0; y < height; ++y) {
+            if (progressOutput_ && y % 50 == 0) std::cout << "Scanline " << y << "/" << height << "\n"; // progress output
 
-                    auto hit = scene.rayHit(ray, Interval(0.001, infinity));
-                    if (hit) {
-                        
-                        Vector3 normal = hit->surfaceNormal_;
-                        Vector3 lightDir = Vector3(5, 1, -1).unitVector();  // Light direction
-                        Vector3 viewDir = (-ray.direction()).unitVector();  // View (camera) direction
+            std::fill(red.begin(), red.end(), 0.0f);
+            std::fill(green.begin(), green.end(), 0.0f);
+            std::fill(blue.begin(), blue.end(), 0.0f);
+            batch.clear();
 
-                        // Reflect light around normal
-                        Vector3 reflectDir = (2 * normal.dot(lightDir) * normal - lightDir).unitVector();
+            for (int x = 0; x < width; ++x) {
+                for (int s = 0; s < samplesPerPixel; ++s) {
+                    Ray ray = cameraRay<Features::antiAliasing>(camera, x, y, width, height);
+                    traceIntoBatch<Features, Features::reflectionDepth>(scene, ray, sampleWeight, x, reflectivity,
+                                                                        batch, red.data(), green.data(), blue.data());
+                }
+            }
+
+            batch.shadeInto(phongMaterial_, red.data(), green.data(), blue.data());
+
+            uint32_t* row = pixels + size_t(y) * width;
+            if constexpr (Features::gamma == GammaMode::Gamma2) {
+                packGamma2ARGB(red.data(), green.data(), blue.data(), row, width);
+            }
+            else {
+                for (int x = 0; x < width; ++x) row[x] = toARGB<GammaMode::Linear>(Color3(red[x], green[x], blue[x]));
+            }
+        }
 
-                        // Material properties
-                        Color3 objectColor = Color3(0.0, 0.0, 0.1);   // (R, G, B)
-                        Color3 lightColor = Color3(10.0, 10.0, 10.0);    // White light
-                        float k_d = 0.8f;    // Diffuse coefficient
-                        float k_s = 0.2f;    // Specular coefficient
-                        float shininess = 300.0f;  // Gloss factor
+        if (progressOutput_) std::cout << "Rendering complete.\n";
+    }
 
-                        // Diffuse shading
-                        double diffuse = std::max(0.0, normal.dot(lightDir));
+    // Same image as renderKernel with Features::reflectionDepth set to parameters.reflectionDepth(), traced
+    // breadth-first instead of per pixel: a band of scanlines is traced, every object hit queues a reflected
+    // ray, and each bounce level is traced as one batch, put in coherence order first if parameters ask for it.
+    // Object hits are shaded like renderKernel (ExactMath) or renderKernelBatched.
+    // If parameters batch shadow rays (and the scene has lights), shadow rays from object hits and the checker
+    // floor are queued too, carrying their unshadowed contribution, and resolved as one batch at the end of the band.
+    // Off by default: testing a shadow ray right after its hit is already coherent, batching only adds traffic.
+    template <typename Features, bool ExactMath>
+    void renderReflectiveKernel(const Scene& scene, const Camera& camera, uint32_t* pixels, int width, int height, const RendererParameters& parameters) {
+        const int samplesPerPixel = Features::antiAliasing ? parameters.samplesPerPixel() : 1;
+        const int maximumDepth = parameters.reflectionDepth();
+        const double reflectivity = parameters.reflectivity();
+        const bool sortRays = parameters.sortSecondaryRays();
+        const int rowsPerBatch = 32;
+        const size_t pixelCount = size_t(width) * height;
+        std::vector<SecondaryRay> batch;
+        std::vector<SecondaryRay> nextBatch;
+        std::vector<SecondaryRay> shadowRays;
+        const bool deferShadows = Features::shadows && parameters.batchShadowRays() && scene.hasLights();
+        size_t secondaryRays = 0;
+        std::chrono::duration<double> secondaryTime(0);
+
+        // Exact: double colour per pixel. Batched: float planes the ShadingBatch scatters into.
+        std::vector<Color3> accumulated;
+        std::vector<float> red, green, blue;
+        std::vector<float> shadowRed, shadowGreen, shadowBlue;   // batched: Phong colour of each queued shadow ray
+        ShadingBatch& shadingBatch = *shadingBatch_;
+        if constexpr (ExactMath) {
+            accumulated.resize(pixelCount);
+        }
+        else {
+            red.assign(pixelCount, 0.0f);
+            green.assign(pixelCount, 0.0f);
+            blue.assign(pixelCount, 0.0f);
+            shadingBatch.clear();
+        }
 
-                        // Specular highlight
-                        double specular = std::pow(std::max(0.0, viewDir.dot(reflectDir)), shininess);
+        auto addColor = [&](uint32_t pixelIndex, const Color3& color) {
+            if constexpr (ExactMath) {
+                accumulated[pixelIndex] += color;
+            }
+            else {
+                red[pixelIndex] += float(color.x());
+                green[pixelIndex] += float(color.y());
+                blue[pixelIndex] += float(color.z());
+            }
+        };
+        auto queueShadowRay = [&](const Point3& point, const Vector3& normal, const LightSample& lightSample,
+                                  const Color3& contribution, uint32_t pixelIndex) {
+            Ray shadowRay(point + 0.001 * normal, lightSample.direction);
+            shadowRays.push_back(SecondaryRay{ shadowRay, contribution, pixelIndex, lightSample.distance });
+            if constexpr (!ExactMath) {   // batch shaded entries add their colour here at resolve time
+                shadowRed.push_back(0.0f);
+                shadowGreen.push_back(0.0f);
+                shadowBlue.push_back(0.0f);
+            }
+        };
+        // Batched shadow entries are keyed by shadow ray, not pixel, so shading fills in each ray's contribution
+        auto flushShadowShading = [&]() {
+            shadingBatch.shadeInto(phongMaterial_, shadowRed.data(), shadowGreen.data(), shadowBlue.data());
+            shadingBatch.clear();
+        };
+        auto resolveShadowRays = [&]() {
+            if constexpr (!ExactMath) {
+                flushShadowShading();
+                for (size_t i = 0; i < shadowRays.size(); ++i) shadowRays[i].weight += Color3(shadowRed[i], shadowGreen[i], shadowBlue[i]);
+                shadowRed.clear();
+                shadowGreen.clear();
+                shadowBlue.clear();
+            }
+            if (sortRays) sortRaysForCoherence(shadowRays);
 
-                        // Final shaded color
-                        color = k_d * diffuse * objectColor * lightColor + k_s * specular * lightColor;
+            for (const auto& shadow : shadowRays) {
+                if (!scene.occluded(shadow.ray, shadow.maxDistance)) addColor(shadow.pixelIndex, shadow.weight);
+            }
+            secondaryRays += shadowRays.size();
+            shadowRays.clear();
+        };
+
+        // Ray weights are grey (products of 1 / samplesPerPixel and reflectivity), so one channel stands for all three
+        auto shadeObject = [&](const Ray& ray, const HitRecord& hit, const Color3& weight, uint32_t pixelIndex) {
+            if (deferShadows) {
+                Vector3 normal = hit.surfaceNormal_;
+                Vector3 view = -ray.direction();
+                scene.forEachLightSample(hit.hitPoint_, normal, lightSamples_, [&](const LightSample& lightSample, const Color3& radiance, double lightWeight) {
+                    if constexpr (ExactMath) {
+                        Color3 color = lightWeight * phong(normal, view.unitVector(), lightSample.direction, radiance);
+                        queueShadowRay(hit.hitPoint_, normal, lightSample, weight * color, pixelIndex);
                     }
                     else {
-                        double t = (-0.5 - ray.origin().y()) / ray.direction().y();
-                        if (t > 0) {
-                            Point3 hitPoint = ray.at(t);
-
-                            int checkX = static_cast<int>(std::floor(hitPoint.x()));
-                            int checkZ = static_cast<int>(std::floor(hitPoint.z()));
-                            bool isEven = (checkX + checkZ) % 2 == 0;
-
-                            Color3 baseColor = isEven ? Color3(0.9, 0.9, 0.9) : Color3(0.1, 0.1, 0.1);
-                            Vector3 normal = Vector3(0, 1, 0);
-                            float diffuse = std::max(0.0, normal.dot(lightDirection));
-                            color += diffuse * baseColor;
-                        }
-                        else {
-                            Vector3 unitDirection = ray.direction().unitVector();
-                            float t = 0.5f * (unitDirection.y() + 1.0f);
-                            color += (1.0f - t) * Color3(1.0, 1.0, 1.0) + t * Color3(0.5, 0.7, 1.0);
-                        }
+                        if (shadingBatch.full()) flushShadowShading();
+                        shadingBatch.add(normal, view, lightSample.direction, radiance, float(weight.x()) * float(lightWeight), int(shadowRays.size()));
+                        queueShadowRay(hit.hitPoint_, normal, lightSample, Color3(0, 0, 0), pixelIndex);
                     }
+                });
+                return;
+            }
+
+            if constexpr (ExactMath) {
+                accumulated[pixelIndex] += weight * shadeHit<Features::shadows>(scene, ray, hit);
+            }
+            else {
+                queueHitShading<Features::shadows>(scene, ray, hit, float(weight.x()), int(pixelIndex), shadingBatch,
+                                                   red.data(), green.data(), blue.data());
+            }
+        };
+        // Floor and sky. Textured floor materials shade (and shadow test) as a whole, only the checker is deferred.
+        auto shadeBackground = [&](const Ray& ray, const Color3& weight, uint32_t pixelIndex) {
+            if constexpr (Features::floorPlane) {
+                double t = (-0.5 - ray.origin().y()) / ray.direction().y();
+                if (deferShadows && t > 0 && floorMaterial_ == nullptr) {
+                    Point3 hitPoint = ray.at(t);
+                    Vector3 normal = Vector3(0, 1, 0);
+                    Color3 baseColor = weight * checkerColor(hitPoint);
+                    scene.forEachLightSample(hitPoint, normal, lightSamples_, [&](const LightSample& lightSample, const Color3& radiance, double lightWeight) {
+                        Color3 contribution = baseColor * ((lightWeight * normal.dot(lightSample.direction)) * radiance);
+                        queueShadowRay(hitPoint, normal, lightSample, contribution, pixelIndex);
+                    });
+                }
+                else {
+                    addColor(pixelIndex, weight * shadeMiss<Features::shadows>(scene, ray));
                 }
+            }
+            else {
+                addColor(pixelIndex, weight * shadeSky(ray));
+            }
+        };
 
-                // Average and gamma correct
-                color /= samplesPerPixel;
-                color = Color3(std::sqrt(color.x()), std::sqrt(color.y()), std::sqrt(color.z()));
+        if (progressOutput_) std::cout << "Starting render with " << maximumDepth << " reflection bounces"
+                  << (sortRays ? " (coherence sorted)" : " (unsorted)") << "...\n";
+
+        for (int firstRow = 0; firstRow < height; firstRow += rowsPerBatch) {
+            int lastRow = std::min(height, firstRow + rowsPerBatch);
+            batch.clear();
+
+            for (int y = firstRow; y < lastRow; ++y) {
+                for (int x = 0; x < width; ++x) {
+                    uint32_t pixelIndex = uint32_t(y * width + x);
+
+                    for (int s = 0; s < samplesPerPixel; ++s) {
+                        Ray ray = cameraRay<Features::antiAliasing>(camera, x, y, width, height);
+                        Color3 weight = Color3(1.0, 1.0, 1.0) / samplesPerPixel;
+                        traceBatchedRay(scene, ray, weight, pixelIndex, reflectivity, maximumDepth > 0, batch, shadeBackground, shadeObject);
+                    }
+                }
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            for (int depth = 1; depth <= maximumDepth && !batch.empty(); ++depth) {
+                if (sortRays) sortRaysForCoherence(batch);
+
+                nextBatch.clear();
+                for (const auto& secondary : batch) {
+                    traceBatchedRay(scene, secondary.ray, secondary.weight, secondary.pixelIndex, reflectivity,
+                                    depth < maximumDepth, nextBatch, shadeBackground, shadeObject);
+                }
+                secondaryRays += batch.size();
+                std::swap(batch, nextBatch);
+            }
+            if (deferShadows) resolveShadowRays();
+            secondaryTime += std::chrono::steady_clock::now() - start;
+        }
 
-                uint8_t r8 = static_cast<uint8_t>(255.999 * clamp(color.x(), 0.0f, 1.0f));
-                uint8_t g8 = static_cast<uint8_t>(255.999 * clamp(color.y(), 0.0f, 1.0f));
-                uint8_t b8 = static_cast<uint8_t>(255.999 * clamp(color.z(), 0.0f, 1.0f));
-                pixels[y * width + x] = (255 << 24) | (r8 << 16) | (g8 << 8) | b8;
+        if constexpr (ExactMath) {
+            for (size_t i = 0; i < pixelCount; ++i) pixels[i] = toARGB<Features::gamma>(accumulated[i]);
+        }
+        else {
+            shadingBatch.shadeInto(phongMaterial_, red.data(), green.data(), blue.data());
+            if constexpr (Features::gamma == GammaMode::Gamma2) {
+                packGamma2ARGB(red.data(), green.data(), blue.data(), pixels, int(pixelCount));
+            }
+            else {
+                for (size_t i = 0; i < pixelCount; ++i) pixels[i] = toARGB<GammaMode::Linear>(Color3(red[i], green[i], blue[i]));
             }
         }
 
-        std::cout << "Rendering complete.\n";
+        double seconds = secondaryTime.count();
+        if (progressOutput_) std::cout << "Rendering complete. " << secondaryRays << " secondary rays in " << seconds * 1000.0 << " ms ("
+                  << (seconds > 0.0 ? secondaryRays / seconds / 1.0e6 : 0.0) << " Mrays/s)\n";
     }
 
-private:
-    RendererParameters rendererParams_{};
-    Camera camera_;
-    Scene world_;
-    std::ofstream outFile_;
+    // Batched counterpart of traceColor: misses are shaded straight into the row, object hits are queued
+    template <typename Features, int Depth>
+    void traceIntoBatch(const Scene& scene, const Ray& ray, float weight, int pixel, float reflectivity,
+                        ShadingBatch& batch, float* red, float* green, float* blue) const {
+        auto hit = scene.rayHit(ray, Interval(0.001, infinity));
+        if (!hit) {
+            Color3 color;
+            if constexpr (Features::floorPlane) color = shadeMiss<Features::shadows>(scene, ray);
+            else color = shadeSky(ray);
+            red[pixel] += weight * float(color.x());
+            green[pixel] += weight * float(color.y());
+            blue[pixel] += weight * float(color.z());
+            return;
+        }
+
+        float localWeight = (Depth > 0) ? weight * (1.0f - reflectivity) : weight;
+        queueHitShading<Features::shadows>(scene, ray, *hit, localWeight, pixel, batch, red, green, blue);
+
+        if constexpr (Depth > 0) {
+            traceIntoBatch<Features, Depth - 1>(scene, mirrorRay(ray, *hit), weight * reflectivity, pixel, reflectivity, batch, red, green, blue);
+        }
+    }
+
+    // Queues one Phong evaluation per light that reaches the hit, flushing the batch when it fills up
+    template <bool Shadows>
+    void queueHitShading(const Scene& scene, const Ray& ray, const HitRecord& hit, float weight, int pixel,
+                         ShadingBatch& batch, float* red, float* green, float* blue) const {
+        Vector3 view = -ray.direction();
+
+        forEachLightSample<Shadows>(scene, hit, [&](const Vector3& lightDir, const Color3& lightColor, double lightWeight) {
+            if (batch.full()) {
+                batch.shadeInto(phongMaterial_, red, green, blue);
+                batch.clear();
+            }
+            batch.add(hit.surfaceNormal_, view, lightDir, lightColor, weight * float(lightWeight), pixel);
+        });
+    }
+
+    // Lights reaching one object hit, shared by the exact and batched shading paths: the built-in directional
+    // light when the scene has none, otherwise Scene::forEachLightSample with lightSamples_ picks, shadow tested
+    // if Shadows. Calls visit(direction, radiance, weight) for each.
+    template <bool Shadows, typename Visit>
+    void forEachLightSample(const Scene& scene, const HitRecord& hit, Visit&& visit) const {
+        if (!scene.hasLights()) {
+            visit(Vector3(5, 1, -1).unitVector(), Color3(10.0, 10.0, 10.0), 1.0);   // white light
+            return;
+        }
+
+        Vector3 normal = hit.surfaceNormal_;
+        scene.forEachLightSample(hit.hitPoint_, normal, lightSamples_, [&](const LightSample& lightSample, const Color3& radiance, double weight) {
+            if constexpr (Shadows) {
+                if (scene.occluded(hit.hitPoint_ + 0.001 * normal, lightSample)) return;
+            }
+            visit(lightSample.direction, radiance, weight);
+        });
+    }
+
+    // Colour seen along one ray, following up to Depth mirror bounces
+    template <typename Features, int Depth>
+    Color3 traceColor(const Scene& scene, const Ray& ray, double reflectivity) const {
+        auto hit = scene.rayHit(ray, Interval(0.001, infinity));
+        if (!hit) {
+            if constexpr (Features::floorPlane) return shadeMiss<Features::shadows>(scene, ray);
+            else return shadeSky(ray);
+        }
+
+        Color3 local = shadeHit<Features::shadows>(scene, ray, *hit);
+        if constexpr (Depth > 0) {
+            return (1.0 - reflectivity) * local + reflectivity * traceColor<Features, Depth - 1>(scene, mirrorRay(ray, *hit), reflectivity);
+        }
+        else {
+            return local;
+        }
+    }
+
+    // Phong shading for object hits. Uses the scene's lights when it has any,
+    // otherwise the single built-in directional light.
+    template <bool Shadows>
+    Color3 shadeHit(const Scene& scene, const Ray& ray, const HitRecord& hit) const {
+        Vector3 normal = hit.surfaceNormal_;
+        Vector3 viewDir = (-ray.direction()).unitVector();  // View (camera) direction
+
+        Color3 color(0, 0, 0);
+        forEachLightSample<Shadows>(scene, hit, [&](const Vector3& lightDir, const Color3& lightColor, double weight) {
+            color += weight * phong(normal, viewDir, lightDir, lightColor);
+        });
+        return color;
+    }
 
-    Color3 rayColor(const Ray& ray, const Scene& scene, int depth) {
-        if (depth <= 0)
-            return Color3(0, 0, 0);  // Recursion limit hit
+    // Phong response of phongMaterial_ to one light, viewDir is unit length
+    Color3 phong(const Vector3& normal, const Vector3& viewDir, const Vector3& lightDir, const Color3& lightColor) const {
+        // Material properties
+        Color3 objectColor = Color3(phongMaterial_.red, phongMaterial_.green, phongMaterial_.blue);   // (R, G, B)
+        float k_d = phongMaterial_.diffuse;    // Diffuse coefficient
+        float k_s = phongMaterial_.specular;   // Specular coefficient
+        float shininess = float(phongMaterial_.shininess);  // Gloss factor
 
-        if (auto hit = scene.rayHit(ray, Interval(0.001, infinity))) {
-            Vector3 normal = hit->surfaceNormal_;
-            Point3 hitPoint = hit->hitPoint_;
+        // Reflect light around normal
+        Vector3 reflectDir = (2 * normal.dot(lightDir) * normal - lightDir).unitVector();
 
-            // Calculate perfect mirror reflection
-            Vector3 reflectedDir = ray.direction().unitVector().reflectionAboutNormalVector(normal);
+        // Diffuse shading
+        double diffuse = std::max(0.0, normal.dot(lightDir));
 
-            // Offset the ray origin slightly to avoid shadow acne
-            Ray reflectedRay(hitPoint + 0.001 * normal, reflectedDir);
+        // Specular highlight
+        double specular = std::pow(std::max(0.0, viewDir.dot(reflectDir)), shininess);
+
+        return k_d * diffuse * objectColor * lightColor + k_s * specular * lightColor;
+    }
 
-            // Recursively trace the reflected ray
-            return rayColor(reflectedRay, scene, depth - 1);
+    // Checkerboard floor at y = -0.5, or the sky gradient above the horizon
+    template <bool Shadows>
+    Color3 shadeMiss(const Scene& scene, const Ray& ray) const {
+        Vector3 lightDirection = Vector3(1, 1, -1).unitVector();
+
+        double t = (-0.5 - ray.origin().y()) / ray.direction().y();
+        if (t > 0 && floorMaterial_ != nullptr) {
+            HitRecord floorHit;
+            floorHit.distanceAlongRay_ = t;
+            floorHit.hitPoint_ = ray.at(t);
+            floorHit.surfaceNormal_ = Vector3(0, 1, 0);
+            return floorMaterial_->shade(ray, floorHit, scene, Shadows, lightSamples_);
+        }
+        else if (t > 0) {
+            Point3 hitPoint = ray.at(t);
+            Color3 baseColor = checkerColor(hitPoint);
+            Vector3 normal = Vector3(0, 1, 0);
+            if (scene.hasLights()) {
+                return baseColor * scene.diffuseLighting(hitPoint, normal, lightSamples_, Shadows);
+            }
+            float diffuse = std::max(0.0, normal.dot(lightDirection));
+            return diffuse * baseColor;
         }
 
-        // Background gradient
+        return shadeSky(ray);
+    }
+
+    // Built-in floor pattern: unit squares alternating light and dark grey
+    static Color3 checkerColor(const Point3& hitPoint) {
+        int checkX = static_cast<int>(std::floor(hitPoint.x()));
+        int checkZ = static_cast<int>(std::floor(hitPoint.z()));
+        bool isEven = (checkX + checkZ) % 2 == 0;
+
+        return isEven ? Color3(0.9, 0.9, 0.9) : Color3(0.1, 0.1, 0.1);
+    }
+
+    // Perfect mirror bounce of ray at hit, shared by all reflection paths
+    static Ray mirrorRay(const Ray& ray, const HitRecord& hit) {
+        Vector3 normal = hit.surfaceNormal_;
+        Vector3 reflectedDir = ray.direction().unitVector().reflectionAboutNormalVector(normal);
+        return Ray(hit.hitPoint_ + 0.001 * normal, reflectedDir);   // offset to avoid acne
+    }
+
+    static Color3 shadeSky(const Ray& ray) {
         Vector3 unitDirection = ray.direction().unitVector();
         float t = 0.5f * (unitDirection.y() + 1.0f);
         return (1.0f - t) * Color3(1.0, 1.0, 1.0) + t * Color3(0.5, 0.7, 1.0);
     }
 
+    // Gamma correct and pack to ARGB8888
+    template <GammaMode Gamma>
+    static uint32_t toARGB(Color3 color) {
+        if constexpr (Gamma == GammaMode::Gamma2) {
+            color = Color3(std::sqrt(color.x()), std::sqrt(color.y()), std::sqrt(color.z()));
+        }
+
+        uint8_t r8 = static_cast<uint8_t>(255.999 * clamp(color.x(), 0.0f, 1.0f));
+        uint8_t g8 = static_cast<uint8_t>(255.999 * clamp(color.y(), 0.0f, 1.0f));
+        uint8_t b8 = static_cast<uint8_t>(255.999 * clamp(color.z(), 0.0f, 1.0f));
+        return (255u << 24) | (r8 << 16) | (g8 << 8) | b8;
+    }
+
+    // Shades one ray of a batch into its pixel. Object hits keep (1 - reflectivity) of their own colour
+    // and, if spawnReflection, queue the mirror ray carrying the rest. shadeBackground(ray, weight, pixel)
+    // shades a miss, shadeObject(ray, hit, weight, pixel) an object hit.
+    template <typename ShadeBackground, typename ShadeObject>
+    void traceBatchedRay(const Scene& scene, const Ray& ray, const Color3& weight, uint32_t pixelIndex, double reflectivity,
+                         bool spawnReflection, std::vector<SecondaryRay>& queue, ShadeBackground& shadeBackground,
+                         ShadeObject& shadeObject) const {
+        auto hit = scene.rayHit(ray, Interval(0.001, infinity));
+        if (!hit) {
+            shadeBackground(ray, weight, pixelIndex);
+            return;
+        }
+
+        if (!spawnReflection) {
+            shadeObject(ray, *hit, weight, pixelIndex);
+            return;
+        }
+
+        shadeObject(ray, *hit, (1.0 - reflectivity) * weight, pixelIndex);
+
+        queue.push_back(SecondaryRay{ mirrorRay(ray, *hit), reflectivity * weight, pixelIndex });
+    }
+
 };
 
 #endif //RAYTRACER_RENDERER_H
@@ -2,8 +2,11 @@
 #ifndef RAYTRACER_SCENE_H
 #define RAYTRACER_SCENE_H
 
+#include "AABB.h"
 #include "HelperFunctions.h"
 #include "Interval.h"
+#include "Light.h"
+#include "LightBVH.h"
 #include "Ray.h"
 #include "Vector3.h"
 #include "Material.h"
@@ -26,7 +29,15 @@ public:
 
 class Object {
 public:
+    virtual ~Object() = default;
+
     virtual std::optional<HitRecord> rayHit(const Ray& ray, Interval rayInterval) const = 0;
+
+    // World-space bounds, nullopt for unbounded objects (e.g. planes)
+    virtual std::optional<AABB> boundingBox() const { return std::nullopt; }
+
+    // Moves the object in place, returns false for objects that don't support it
+    virtual bool translate(const Vector3& offset) { return false; }
 };
 
 
@@ -63,6 +74,16 @@ public:
         return rec;
     }
 
+    std::optional<AABB> boundingBox() const override {
+        Vector3 r(radius_, radius_, radius_);
+        return AABB(center_ - r, center_ + r);
+    }
+
+    bool translate(const Vector3& offset) override {
+        center_ += offset;
+        return true;
+    }
+
 private:
     Point3 center_;
     double radius_;
@@ -99,15 +120,24 @@ public:
         if (discriminant < 0) return std::nullopt;
 
         double sqrtD = std::sqrt(discriminant);
-        double root = (-b - sqrtD) / (2 * a);
-        if (!rayInterval.surrounds(root)) {
-            root = (-b + sqrtD) / (2 * a);
-            if (!rayInterval.surrounds(root)) return std::nullopt;
+        double nearRoot = (-b - sqrtD) / (2 * a);
+        double farRoot = (-b + sqrtD) / (2 * a);
+        if (nearRoot > farRoot) std::swap(nearRoot, farRoot);   // a < 0 flips the order
+
+        // Nearest root that is in range and on the finite part of the cone
+        auto onCone = [&](double t) {
+            if (!rayInterval.surrounds(t)) return false;
+            double localY = apex_.y() - ray.at(t).y();
+            return localY >= 0 && localY <= height_;
+        };
+
+        double root = nearRoot;
+        if (!onCone(root)) {
+            root = farRoot;
+            if (!onCone(root)) return std::nullopt;
         }
 
         Point3 hitPoint = ray.at(root);
-        double localY = apex_.y() - hitPoint.y();
-        if (localY < 0 || localY > height_) return std::nullopt;
 
         HitRecord rec;
         rec.distanceAlongRay_ = root;
@@ -124,6 +154,17 @@ public:
         return rec;
     }
 
+    // Apex on top, base circle height_ below it
+    std::optional<AABB> boundingBox() const override {
+        return AABB(Point3(apex_.x() - radius_, apex_.y() - height_, apex_.z() - radius_),
+                    Point3(apex_.x() + radius_, apex_.y(), apex_.z() + radius_));
+    }
+
+    bool translate(const Vector3& offset) override {
+        apex_ += offset;
+        return true;
+    }
+
 private:
     Point3 apex_;
     double height_;
@@ -181,6 +222,66 @@ public:
 
     void clear() {
         objects_.clear();
+        lights_.clear();
+        lightTreeBuilt_ = false;
+    }
+
+    // Lights are kept separately from the geometry, they don't show up in rayHit
+    void addLight(const Light* light) {
+        lights_.push_back(light);
+        lightTreeBuilt_ = false;
+    }
+
+    const std::vector<const Light*>& lights() const { return lights_; }
+    bool hasLights() const { return !lights_.empty(); }
+
+    // Picks one light for the shading point in proportion to its estimated contribution.
+    // The light hierarchy is (re)built on first use after lights change.
+    std::optional<LightChoice> sampleLight(const Point3& point, const Vector3& normal) const {
+        if (!lightTreeBuilt_) buildLightHierarchy();
+        return lightTree_.sample(point, normal);
+    }
+
+    // Builds the light hierarchy now instead of on the first sample
+    void buildLightHierarchy() const {
+        lightTree_.build(lights_);
+        lightTreeBuilt_ = true;
+    }
+
+    // Shadow test between a point and a light sample
+    bool occluded(const Point3& point, const LightSample& lightSample) const {
+        return occluded(Ray(point, lightSample.direction), lightSample.distance);
+    }
+
+    // Shadow test along a ray towards a light `distance` away
+    bool occluded(const Ray& shadowRay, double distance) const {
+        return rayHit(shadowRay, Interval(0.001, distance - 0.001)).has_value();
+    }
+
+    // The light loop every lit surface goes through: picks `samples` lights for the shading point and calls
+    // visit(lightSample, radiance / pick probability, 1.0 / samples) for each one in front of the surface.
+    // Shadow rays are left to the caller, which can test them right away (occluded) or batch them.
+    template <typename Visit>
+    void forEachLightSample(const Point3& point, const Vector3& normal, int samples, Visit&& visit) const {
+        for (int i = 0; i < samples; ++i) {
+            auto choice = sampleLight(point, normal);
+            if (!choice) continue;
+
+            LightSample lightSample = choice->light->sample(point);
+            if (normal.dot(lightSample.direction) <= 0.0) continue;
+
+            visit(lightSample, lightSample.radiance / choice->probability, 1.0 / samples);
+        }
+    }
+
+    // Monte Carlo estimate of diffuse irradiance (cosine-weighted incoming light) at a point from the scene's lights
+    Color3 diffuseLighting(const Point3& point, const Vector3& normal, int samples = 1, bool shadows = true) const {
+        Color3 total(0, 0, 0);
+        forEachLightSample(point, normal, samples, [&](const LightSample& lightSample, const Color3& radiance, double weight) {
+            if (shadows && occluded(point + 0.001 * normal, lightSample)) return;
+            total += (weight * normal.dot(lightSample.direction)) * radiance;
+        });
+        return total;
     }
 
     std::optional<HitRecord> rayHit(const Ray& ray, Interval rayInterval) const override {
@@ -198,8 +299,21 @@ public:
 
         return hitAnything ? std::optional<HitRecord>{tempHitRecord} : std::nullopt;
     }
+
+    std::optional<AABB> boundingBox() const override {
+        AABB bounds;
+        for (const auto& o : objects_) {
+            auto objectBounds = o->boundingBox();
+            if (!objectBounds) return std::nullopt;
+            bounds.expand(*objectBounds);
+        }
+        return bounds;
+    }
 private:
     std::vector<Object*> objects_{};
+    std::vector<const Light*> lights_{};
+    mutable LightBVH lightTree_;
+    mutable bool lightTreeBuilt_{ false };
 };
 
 #endif //RAYTRACER_SCENE_H
@@ -0,0 +1,105 @@
+#ifndef RAYTRACER_SCENELOADER_H
+#define RAYTRACER_SCENELOADER_H
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Instance.h"
+#include "Light.h"
+#include "Scene.h"
+
+// A scene built from a text description, owning its objects and lights.
+// One statement per line, '#' starts a comment:
+//
+//   sphere <cx> <cy> <cz> <radius>
+//   cone <apexX> <apexY> <apexZ> <height> <radius>
+//   plane <px> <py> <pz> <nx> <ny> <nz>
+//   pointlight <x> <y> <z> <r> <g> <b>
+//   spherelight <x> <y> <z> <radius> <r> <g> <b>
+//
+// Bounded objects are put in a BVH (an InstanceGroup with identity transforms) and the light
+// hierarchy is built up front, so a loaded scene is ready to trace straight away.
+class LoadedScene {
+public:
+    LoadedScene() = default;
+    LoadedScene(const LoadedScene&) = delete;
+    LoadedScene& operator=(const LoadedScene&) = delete;
+
+    // Returns false and fills error on the first bad line
+    bool parse(const std::string& text, std::string& error) {
+        std::istringstream input(text);
+        std::string line;
+        int lineNumber = 0;
+
+        while (std::getline(input, line)) {
+            ++lineNumber;
+            line = line.substr(0, line.find('#'));
+
+            std::istringstream statement(line);
+            std::string keyword;
+            if (!(statement >> keyword)) continue;
+
+            double v[8];
+            auto readValues = [&](int count) {
+                for (int i = 0; i < count; ++i) {
+                    if (!(statement >> v[i])) return false;
+                }
+                return true;
+            };
+
+            bool ok = true;
+            if (keyword == "sphere" && (ok = readValues(4))) {
+                objects_.push_back(std::make_unique<Sphere>(Point3(v[0], v[1], v[2]), v[3]));
+            }
+            else if (keyword == "cone" && (ok = readValues(5))) {
+                objects_.push_back(std::make_unique<Cone>(Point3(v[0], v[1], v[2]), v[3], v[4]));
+            }
+            else if (keyword == "plane" && (ok = readValues(6))) {
+                objects_.push_back(std::make_unique<Plane>(Point3(v[0], v[1], v[2]), Vector3(v[3], v[4], v[5])));
+            }
+            else if (keyword == "pointlight" && (ok = readValues(6))) {
+                lights_.push_back(std::make_unique<PointLight>(Point3(v[0], v[1], v[2]), Color3(v[3], v[4], v[5])));
+            }
+            else if (keyword == "spherelight" && (ok = readValues(7))) {
+                lights_.push_back(std::make_unique<SphereLight>(Point3(v[0], v[1], v[2]), v[3], Color3(v[4], v[5], v[6])));
+            }
+            else if (ok) {
+                error = "line " + std::to_string(lineNumber) + ": unknown statement '" + keyword + "'";
+                return false;
+            }
+
+            if (!ok) {
+                error = "line " + std::to_string(lineNumber) + ": missing values for '" + keyword + "'";
+                return false;
+            }
+        }
+
+        build();
+        return true;
+    }
+
+    const Scene& scene() const { return scene_; }
+    size_t objectCount() const { return objects_.size(); }
+    size_t lightCount() const { return lights_.size(); }
+
+private:
+    std::vector<std::unique_ptr<Object>> objects_;
+    std::vector<std::unique_ptr<Light>> lights_;
+    InstanceGroup bounded_;
+    Scene scene_;
+
+    void build() {
+        for (const auto& object : objects_) {
+            if (object->boundingBox()) bounded_.add(object.get(), Transform());
+            else scene_.add(object.get());
+        }
+        bounded_.build();
+        scene_.add(&bounded_);
+
+        for (const auto& light : lights_) scene_.addLight(light.get());
+        scene_.buildLightHierarchy();
+    }
+};
+
+#endif //RAYTRACER_SCENELOADER_H
@@ -0,0 +1,185 @@
+#ifndef RAYTRACER_SHADINGBATCH_H
+#define RAYTRACER_SHADINGBATCH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "Color3.h"
+
+// Approximate math used by the batched shading path. Error bounds (relative):
+//   rsqrt:   < 2e-6     (hardware estimate + one Newton-Raphson step)
+//   powInt:  < n * 6e-8 for exact inputs (square-and-multiply in float)
+// Combined, an input error e becomes about n * e after the power, so the specular term is off by
+// < n * (2e-6 + 6e-8), about 6e-4 relative for the Phong exponent 300; the diffuse term only by float
+// rounding. Measured on the default scene, the packed output stays within one 8-bit step of the
+// exact double-precision path.
+namespace FastMath {
+    inline float rsqrt(float x) {
+#if defined(__SSE2__)
+        __m128 v = _mm_set_ss(x);
+        __m128 estimate = _mm_rsqrt_ss(v);
+        // y' = y * (1.5 - 0.5 * x * y * y)
+        __m128 refined = _mm_mul_ss(estimate, _mm_sub_ss(_mm_set_ss(1.5f),
+                         _mm_mul_ss(_mm_mul_ss(_mm_set_ss(0.5f), v), _mm_mul_ss(estimate, estimate))));
+        return _mm_cvtss_f32(refined);
+#else
+        return 1.0f / std::sqrt(x);
+#endif
+    }
+
+    // x^n for a non-negative integer n, log2(n) squarings instead of exp/log
+    inline float powInt(float x, int n) {
+        float result = 1.0f;
+        while (n > 0) {
+            if (n & 1) result *= x;
+            x *= x;
+            n >>= 1;
+        }
+        return result;
+    }
+
+#if defined(__SSE2__)
+    inline __m128 rsqrt(__m128 x) {
+        __m128 estimate = _mm_rsqrt_ps(x);
+        return _mm_mul_ps(estimate, _mm_sub_ps(_mm_set1_ps(1.5f),
+               _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), x), _mm_mul_ps(estimate, estimate))));
+    }
+
+    inline __m128 powInt(__m128 x, int n) {
+        __m128 result = _mm_set1_ps(1.0f);
+        while (n > 0) {
+            if (n & 1) result = _mm_mul_ps(result, x);
+            x = _mm_mul_ps(x, x);
+            n >>= 1;
+        }
+        return result;
+    }
+#endif
+}
+
+
+// Fixed Phong material used by the renderer for object hits
+struct PhongMaterial {
+    float red{ 0.0f }, green{ 0.0f }, blue{ 0.1f };   // object colour
+    float diffuse{ 0.8f };                           // k_d
+    float specular{ 0.2f };                          // k_s
+    int shininess{ 300 };
+};
+
+
+// Hits waiting to be shaded, stored structure-of-arrays so four can be shaded per SSE instruction.
+// Each entry is one (hit, light) pair: the light sample is picked (and shadow tested) when it is queued.
+struct ShadingBatch {
+    static constexpr int capacity = 256;
+
+    alignas(16) float normalX[capacity], normalY[capacity], normalZ[capacity];
+    alignas(16) float viewX[capacity], viewY[capacity], viewZ[capacity];     // not normalized
+    alignas(16) float lightX[capacity], lightY[capacity], lightZ[capacity];  // unit, towards the light
+    alignas(16) float lightRed[capacity], lightGreen[capacity], lightBlue[capacity];
+    alignas(16) float weight[capacity];
+    int pixel[capacity];
+    int count{ 0 };
+
+    bool full() const { return count == capacity; }
+    void clear() { count = 0; }
+
+    void add(const Vector3& normal, const Vector3& view, const Vector3& lightDirection, const Color3& lightColor,
+             float sampleWeight, int pixelIndex) {
+        int i = count++;
+        normalX[i] = float(normal.x()); normalY[i] = float(normal.y()); normalZ[i] = float(normal.z());
+        viewX[i] = float(view.x()); viewY[i] = float(view.y()); viewZ[i] = float(view.z());
+        lightX[i] = float(lightDirection.x()); lightY[i] = float(lightDirection.y()); lightZ[i] = float(lightDirection.z());
+        lightRed[i] = float(lightColor.x()); lightGreen[i] = float(lightColor.y()); lightBlue[i] = float(lightColor.z());
+        weight[i] = sampleWeight;
+        pixel[i] = pixelIndex;
+    }
+
+    // Phong-shades every entry and adds weight * colour to the per-pixel accumulators
+    void shadeInto(const PhongMaterial& material, float* red, float* green, float* blue) const {
+        alignas(16) float diffuseTerm[capacity];
+        alignas(16) float specularTerm[capacity];
+        int i = 0;
+
+#if defined(__SSE2__)
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 two = _mm_set1_ps(2.0f);
+        for (; i + 4 <= count; i += 4) {
+            __m128 nx = _mm_load_ps(normalX + i), ny = _mm_load_ps(normalY + i), nz = _mm_load_ps(normalZ + i);
+            __m128 lx = _mm_load_ps(lightX + i), ly = _mm_load_ps(lightY + i), lz = _mm_load_ps(lightZ + i);
+            __m128 vx = _mm_load_ps(viewX + i), vy = _mm_load_ps(viewY + i), vz = _mm_load_ps(viewZ + i);
+
+            __m128 nDotL = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, lx), _mm_mul_ps(ny, ly)), _mm_mul_ps(nz, lz));
+
+            // Mirror of the light about the normal; already unit length for unit n and l
+            __m128 twoNDotL = _mm_mul_ps(two, nDotL);
+            __m128 rx = _mm_sub_ps(_mm_mul_ps(twoNDotL, nx), lx);
+            __m128 ry = _mm_sub_ps(_mm_mul_ps(twoNDotL, ny), ly);
+            __m128 rz = _mm_sub_ps(_mm_mul_ps(twoNDotL, nz), lz);
+
+            __m128 viewLengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+            __m128 vDotR = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, rx), _mm_mul_ps(vy, ry)), _mm_mul_ps(vz, rz));
+            vDotR = _mm_mul_ps(vDotR, FastMath::rsqrt(viewLengthSquared));
+
+            _mm_store_ps(diffuseTerm + i, _mm_max_ps(zero, nDotL));
+            _mm_store_ps(specularTerm + i, FastMath::powInt(_mm_max_ps(zero, vDotR), material.shininess));
+        }
+#endif
+        for (; i < count; ++i) {
+            float nDotL = normalX[i] * lightX[i] + normalY[i] * lightY[i] + normalZ[i] * lightZ[i];
+            float rx = 2.0f * nDotL * normalX[i] - lightX[i];
+            float ry = 2.0f * nDotL * normalY[i] - lightY[i];
+            float rz = 2.0f * nDotL * normalZ[i] - lightZ[i];
+
+            float viewLengthSquared = viewX[i] * viewX[i] + viewY[i] * viewY[i] + viewZ[i] * viewZ[i];
+            float vDotR = (viewX[i] * rx + viewY[i] * ry + viewZ[i] * rz) * FastMath::rsqrt(viewLengthSquared);
+
+            diffuseTerm[i] = std::max(0.0f, nDotL);
+            specularTerm[i] = FastMath::powInt(std::max(0.0f, vDotR), material.shininess);
+        }
+
+        // Scatter, several entries can land on the same pixel
+        for (i = 0; i < count; ++i) {
+            float d = material.diffuse * diffuseTerm[i];
+            float s = material.specular * specularTerm[i];
+            float w = weight[i];
+            red[pixel[i]] += w * lightRed[i] * (d * material.red + s);
+            green[pixel[i]] += w * lightGreen[i] * (d * material.green + s);
+            blue[pixel[i]] += w * lightBlue[i] * (d * material.blue + s);
+        }
+    }
+};
+
+
+// Gamma 2 (sqrt), clamp and pack a row of linear colours to ARGB8888, four pixels per iteration
+inline void packGamma2ARGB(const float* red, const float* green, const float* blue, uint32_t* out, int count) {
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(255.999f);
+    const __m128i alpha = _mm_set1_epi32(int(0xff000000u));
+
+    auto channel = [&](const float* source) {
+        __m128 v = _mm_sqrt_ps(_mm_max_ps(zero, _mm_loadu_ps(source + i)));
+        v = _mm_min_ps(v, one);
+        return _mm_cvttps_epi32(_mm_mul_ps(v, scale));   // truncation, same as the scalar cast
+    };
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i r = channel(red), g = channel(green), b = channel(blue);
+        __m128i argb = _mm_or_si128(_mm_or_si128(alpha, _mm_slli_epi32(r, 16)), _mm_or_si128(_mm_slli_epi32(g, 8), b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), argb);
+    }
+#endif
+    for (; i < count; ++i) {
+        auto to8 = [](float v) { return uint32_t(255.999f * std::min(1.0f, std::sqrt(std::max(0.0f, v)))); };
+        out[i] = 0xff000000u | (to8(red[i]) << 16) | (to8(green[i]) << 8) | to8(blue[i]);
+    }
+}
+
+#endif //RAYTRACER_SHADINGBATCH_H
@@ -0,0 +1,454 @@
+#ifndef RAYTRACER_TEXTURECACHE_H
+#define RAYTRACER_TEXTURECACHE_H
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Color3.h"
+
+// Read-only memory mapping of a binary PPM (P6, maxval 255).
+// Only the header is parsed up front, pixel rows are paged in by the OS when a tile touches them.
+class MappedImage {
+public:
+    MappedImage() = default;
+    MappedImage(const MappedImage&) = delete;
+    MappedImage& operator=(const MappedImage&) = delete;
+
+    ~MappedImage() {
+        if (mapping_ != nullptr) munmap(mapping_, mappingSize_);
+    }
+
+    bool open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat info {};
+        if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+            ::close(fd);
+            return false;
+        }
+
+        mappingSize_ = static_cast<size_t>(info.st_size);
+        modificationTime_ = static_cast<int64_t>(info.st_mtime);
+        void* mapping = mmap(nullptr, mappingSize_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);   // the mapping keeps the file alive
+        if (mapping == MAP_FAILED) return false;
+        mapping_ = mapping;
+
+        if (!parseHeader()) {
+            munmap(mapping_, mappingSize_);
+            mapping_ = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    size_t fileSize() const { return mappingSize_; }
+    int64_t modificationTime() const { return modificationTime_; }
+
+    // RGB8 row inside the mapping
+    const uint8_t* row(int y) const { return pixels_ + static_cast<size_t>(y) * width_ * 3; }
+
+private:
+    void* mapping_{ nullptr };
+    size_t mappingSize_{ 0 };
+    int64_t modificationTime_{ 0 };
+    const uint8_t* pixels_{ nullptr };
+    int width_{ 0 };
+    int height_{ 0 };
+
+    bool parseHeader() {
+        const char* data = static_cast<const char*>(mapping_);
+        size_t position = 0;
+
+        auto skipWhitespaceAndComments = [&]() {
+            while (position < mappingSize_) {
+                if (data[position] == '#') {
+                    while (position < mappingSize_ && data[position] != '\n') ++position;
+                }
+                else if (std::isspace(static_cast<unsigned char>(data[position]))) {
+                    ++position;
+                }
+                else {
+                    break;
+                }
+            }
+        };
+
+        auto readInt = [&](int& value) {
+            skipWhitespaceAndComments();
+            value = 0;
+            size_t start = position;
+            while (position < mappingSize_ && std::isdigit(static_cast<unsigned char>(data[position]))) {
+                value = value * 10 + (data[position] - '0');
+                ++position;
+            }
+            return position > start;
+        };
+
+        if (mappingSize_ < 2 || data[0] != 'P' || data[1] != '6') return false;
+        position = 2;
+
+        int maximumValue = 0;
+        if (!readInt(width_) || !readInt(height_) || !readInt(maximumValue)) return false;
+        if (width_ <= 0 || height_ <= 0 || maximumValue != 255) return false;
+
+        ++position;   // single whitespace byte before the raster
+        size_t rasterSize = static_cast<size_t>(width_) * height_ * 3;
+        if (position + rasterSize > mappingSize_) return false;
+
+        pixels_ = reinterpret_cast<const uint8_t*>(data + position);
+        return true;
+    }
+};
+
+
+// Coarser mip levels of a MappedImage, kept in a sidecar file next to the source ("<path>.mips").
+// The file is only mapped when the texture is added; a level is box-filtered from the mapped level
+// below the first time a tile of it is needed, and marked as built in the file header, so later runs
+// reuse it. Like level 0 the levels are paged in by the OS on demand. If the sidecar can't be written
+// (read-only directory) an unlinked temporary file is used instead, for this run only.
+class MipChain {
+public:
+    MipChain() = default;
+    MipChain(const MipChain&) = delete;
+    MipChain& operator=(const MipChain&) = delete;
+
+    ~MipChain() {
+        if (mapping_ != nullptr) munmap(mapping_, mappingSize_);
+    }
+
+    static int levelSize(int size, int level) { return std::max(1, size >> level); }
+
+    bool open(const std::string& sourcePath, const MappedImage& image, int levels) {
+        image_ = &image;
+        levelOffsets_.assign(levels, 0);
+        size_t offset = sizeof(Header);
+        for (int level = 1; level < levels; ++level) {
+            levelOffsets_[level] = offset;
+            offset += levelBytes(level);
+        }
+        if (levels == 1) return true;   // 1x1 texture, nothing to filter
+        mappingSize_ = offset;
+
+        int fd = ::open((sourcePath + ".mips").c_str(), O_RDWR | O_CREAT, 0644);
+        FILE* temporary = nullptr;
+        if (fd < 0) {
+            temporary = std::tmpfile();
+            if (temporary == nullptr) return false;
+            fd = fileno(temporary);
+        }
+
+        // Start over unless the file was made for this exact source
+        Header expected = makeHeader();
+        Header existing{};
+        bool reusable = ::pread(fd, &existing, sizeof(existing), 0) == ssize_t(sizeof(existing))
+                     && std::memcmp(existing.magic, expected.magic, sizeof(expected.magic)) == 0
+                     && existing.width == expected.width && existing.height == expected.height
+                     && existing.sourceSize == expected.sourceSize && existing.sourceTime == expected.sourceTime;
+
+        bool ready = reusable || (ftruncate(fd, 0) == 0 && ::pwrite(fd, &expected, sizeof(expected), 0) == ssize_t(sizeof(expected)));
+        void* mapping = MAP_FAILED;
+        if (ready && ftruncate(fd, static_cast<off_t>(mappingSize_)) == 0) {
+            mapping = mmap(nullptr, mappingSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if (temporary != nullptr) std::fclose(temporary);
+        else ::close(fd);   // the mapping keeps the file alive
+        if (mapping == MAP_FAILED) return false;
+        mapping_ = mapping;
+        return true;
+    }
+
+    // RGB8 row of a mip level, filtering the level (and any unbuilt ones below it) on first use
+    const uint8_t* row(int level, int y) {
+        if (level == 0) return image_->row(y);
+        ensureLevel(level);
+        return levelData(level) + static_cast<size_t>(y) * levelSize(image_->width(), level) * 3;
+    }
+
+    // Bytes of the coarse levels built so far, in this run or an earlier one
+    size_t builtBytes() const {
+        size_t bytes = 0;
+        for (int level = 1; level < int(levelOffsets_.size()); ++level) {
+            if (isBuilt(level)) bytes += levelBytes(level);
+        }
+        return bytes;
+    }
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t width;
+        uint32_t height;
+        int64_t sourceSize;
+        int64_t sourceTime;
+        uint32_t builtLevels;   // bit per finished level
+        uint32_t reserved;
+    };
+
+    const MappedImage* image_{ nullptr };
+    void* mapping_{ nullptr };
+    size_t mappingSize_{ 0 };
+    std::vector<size_t> levelOffsets_;
+
+    Header makeHeader() const {
+        Header header{};
+        std::memcpy(header.magic, "RTMIPS1", 8);
+        header.width = uint32_t(image_->width());
+        header.height = uint32_t(image_->height());
+        header.sourceSize = int64_t(image_->fileSize());
+        header.sourceTime = image_->modificationTime();
+        return header;
+    }
+
+    Header& header() const { return *static_cast<Header*>(mapping_); }
+    bool isBuilt(int level) const { return mapping_ != nullptr && (header().builtLevels & (1u << level)) != 0; }
+    size_t levelBytes(int level) const { return size_t(levelSize(image_->width(), level)) * levelSize(image_->height(), level) * 3; }
+    uint8_t* levelData(int level) const { return static_cast<uint8_t*>(mapping_) + levelOffsets_[level]; }
+
+    void ensureLevel(int level) {
+        if (isBuilt(level)) return;
+        if (level > 1) ensureLevel(level - 1);
+        filterLevel(level);
+        header().builtLevels |= 1u << level;   // only after the level is complete
+    }
+
+    // 2x2 box filter of the level below, rounded. An odd last row or column is dropped,
+    // a source dimension of 1 is averaged over that single texel.
+    void filterLevel(int level) {
+        int sourceWidth = levelSize(image_->width(), level - 1);
+        int sourceHeight = levelSize(image_->height(), level - 1);
+        int width = levelSize(image_->width(), level);
+        int height = levelSize(image_->height(), level);
+        uint8_t* destination = levelData(level);
+
+        for (int y = 0; y < height; ++y) {
+            int rows = std::min(2, sourceHeight - 2 * y);
+            for (int x = 0; x < width; ++x) {
+                int columns = std::min(2, sourceWidth - 2 * x);
+                uint32_t sums[3] = { 0, 0, 0 };
+                for (int r = 0; r < rows; ++r) {
+                    const uint8_t* p = row(level - 1, 2 * y + r) + 3 * 2 * x;
+                    for (int c = 0; c < 3 * columns; ++c) sums[c % 3] += p[c];
+                }
+                uint32_t count = uint32_t(rows * columns);
+                for (int channel = 0; channel < 3; ++channel) {
+                    *destination++ = static_cast<uint8_t>((sums[channel] + count / 2) / count);
+                }
+            }
+        }
+    }
+};
+
+
+struct TextureCacheStats {
+    uint64_t hits{ 0 };
+    uint64_t misses{ 0 };
+    uint64_t evictions{ 0 };
+    size_t residentTiles{ 0 };
+    size_t residentBytes{ 0 };
+    size_t budgetBytes{ 0 };
+    size_t mipChainBytes{ 0 };   // built coarse levels, file-backed and outside the tile budget
+
+    double hitRate() const {
+        uint64_t lookups = hits + misses;
+        return lookups == 0 ? 0.0 : double(hits) / double(lookups);
+    }
+
+    friend std::ostream& operator<<(std::ostream& outStream, const TextureCacheStats& s) {
+        return outStream << "Texture cache: " << s.hits << " hits, " << s.misses << " misses ("
+                         << 100.0 * s.hitRate() << "% hit rate), " << s.evictions << " evictions, "
+                         << s.residentTiles << " tiles / " << s.residentBytes / 1024 << " KiB resident of "
+                         << s.budgetBytes / 1024 << " KiB, " << s.mipChainBytes / 1024 << " KiB of mip levels built";
+    }
+};
+
+
+// Tiled, mip-mapped texture cache with a fixed memory budget.
+// Every texture is split into tileSize x tileSize tiles per mip level. Tiles are copied out of the
+// memory-mapped file (level 0) or its MipChain, whose levels are built on first use, so a tile costs
+// one small copy and, once a level exists, a distant lookup never reads level 0. Least recently used tiles are
+// evicted once the resident size goes over budget. Hits and misses count texel lookups.
+class TextureCache {
+public:
+    static constexpr int tileSize = 32;
+
+    explicit TextureCache(size_t budgetBytes = size_t(64) << 20) : budgetBytes_(budgetBytes) {}
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    // Maps the file and returns its texture id, or -1 if it can't be opened
+    int addTexture(const std::string& path) {
+        auto image = std::make_unique<MappedImage>();
+        if (!image->open(path)) {
+            std::cerr << "TextureCache: could not map '" << path << "' (expected binary PPM, maxval 255)\n";
+            return -1;
+        }
+
+        TextureInfo info;
+        info.width = image->width();
+        info.height = image->height();
+        info.levels = 1 + static_cast<int>(std::floor(std::log2(std::max(info.width, info.height))));
+        info.mipChain = std::make_unique<MipChain>();
+        if (!info.mipChain->open(path, *image, info.levels)) {
+            std::cerr << "TextureCache: could not create the mip chain for '" << path << "'\n";
+            return -1;
+        }
+        info.image = std::move(image);
+
+        textures_.push_back(std::move(info));
+        return static_cast<int>(textures_.size()) - 1;
+    }
+
+    int width(int textureId) const { return textures_[textureId].width; }
+    int height(int textureId) const { return textures_[textureId].height; }
+    int levels(int textureId) const { return textures_[textureId].levels; }
+
+    // Bilinear lookup with wrapping (u, v) in [0, 1), on the mip level that matches the footprint.
+    // footprintTexels is the width of the lookup footprint measured in level 0 texels.
+    Color3 sample(int textureId, double u, double v, double footprintTexels) {
+        const TextureInfo& info = textures_[textureId];
+        int level = 0;
+        if (footprintTexels > 1.0) {
+            level = std::min(info.levels - 1, static_cast<int>(std::log2(footprintTexels)));
+        }
+
+        int levelWidth = levelSize(info.width, level);
+        int levelHeight = levelSize(info.height, level);
+
+        double x = (u - std::floor(u)) * levelWidth - 0.5;
+        double y = (v - std::floor(v)) * levelHeight - 0.5;
+        int x0 = static_cast<int>(std::floor(x));
+        int y0 = static_cast<int>(std::floor(y));
+        double fx = x - x0;
+        double fy = y - y0;
+
+        auto wrap = [](int value, int size) { return ((value % size) + size) % size; };
+        int xa = wrap(x0, levelWidth), xb = wrap(x0 + 1, levelWidth);
+        int ya = wrap(y0, levelHeight), yb = wrap(y0 + 1, levelHeight);
+
+        Color3 top = (1.0 - fx) * texel(textureId, level, xa, ya) + fx * texel(textureId, level, xb, ya);
+        Color3 bottom = (1.0 - fx) * texel(textureId, level, xa, yb) + fx * texel(textureId, level, xb, yb);
+        return (1.0 - fy) * top + fy * bottom;
+    }
+
+    // Single texel of a mip level, in linear [0, 1]
+    Color3 texel(int textureId, int level, int x, int y) {
+        uint64_t key = tileKey(textureId, level, x / tileSize, y / tileSize);
+        const Tile* cached = findTile(key);
+        if (cached != nullptr) ++stats_.hits;
+        else ++stats_.misses;
+
+        const Tile& t = cached != nullptr ? *cached : insertTile(key, loadTile(textureId, level, x / tileSize, y / tileSize));
+        const uint8_t* p = &t.rgb[3 * ((y % tileSize) * tileSize + (x % tileSize))];
+        return Color3(p[0] / 255.0, p[1] / 255.0, p[2] / 255.0);
+    }
+
+    TextureCacheStats stats() const {
+        TextureCacheStats s = stats_;
+        s.residentTiles = tiles_.size();
+        s.residentBytes = residentBytes_;
+        s.budgetBytes = budgetBytes_;
+        for (const auto& texture : textures_) s.mipChainBytes += texture.mipChain->builtBytes();
+        return s;
+    }
+
+    void resetStats() { stats_ = TextureCacheStats{}; }
+
+private:
+    struct TextureInfo {
+        std::unique_ptr<MappedImage> image;
+        std::unique_ptr<MipChain> mipChain;   // levels 1 and up, reads level 0 through image
+        int width{ 0 };
+        int height{ 0 };
+        int levels{ 1 };
+    };
+
+    struct Tile {
+        std::vector<uint8_t> rgb;   // tileSize * tileSize RGB8, edge tiles are only partly used
+    };
+
+    struct CacheEntry {
+        Tile tile;
+        std::list<uint64_t>::iterator lruPosition;
+    };
+
+    static constexpr size_t tileBytes = size_t(tileSize) * tileSize * 3;
+
+    size_t budgetBytes_;
+    size_t residentBytes_{ 0 };
+    std::vector<TextureInfo> textures_;
+    std::unordered_map<uint64_t, CacheEntry> tiles_;
+    std::list<uint64_t> lru_;   // front = most recently used
+    TextureCacheStats stats_;
+
+    static int levelSize(int size, int level) { return MipChain::levelSize(size, level); }
+
+    static uint64_t tileKey(int textureId, int level, int tileX, int tileY) {
+        return (uint64_t(textureId) << 48) | (uint64_t(level) << 40) | (uint64_t(tileY) << 20) | uint64_t(tileX);
+    }
+
+    // Resident tile moved to the front of the LRU list, or nullptr
+    const Tile* findTile(uint64_t key) {
+        auto found = tiles_.find(key);
+        if (found == tiles_.end()) return nullptr;
+        lru_.splice(lru_.begin(), lru_, found->second.lruPosition);
+        return &found->second.tile;
+    }
+
+    const Tile& insertTile(uint64_t key, Tile loaded) {
+        lru_.push_front(key);
+        CacheEntry& entry = tiles_[key];
+        entry.tile = std::move(loaded);
+        entry.lruPosition = lru_.begin();
+        residentBytes_ += tileBytes;
+
+        evictOverBudget();
+        return entry.tile;
+    }
+
+    void evictOverBudget() {
+        // Never evicts the front entry, so the tile just handed out stays valid
+        while (residentBytes_ > budgetBytes_ && lru_.size() > 1) {
+            tiles_.erase(lru_.back());
+            lru_.pop_back();
+            residentBytes_ -= tileBytes;
+            ++stats_.evictions;
+        }
+    }
+
+    Tile loadTile(int textureId, int level, int tileX, int tileY) {
+        TextureInfo& info = textures_[textureId];
+        Tile t;
+        t.rgb.assign(tileBytes, 0);
+
+        int x0 = tileX * tileSize;
+        int y0 = tileY * tileSize;
+        int columns = std::min(tileSize, levelSize(info.width, level) - x0);
+        int rows = std::min(tileSize, levelSize(info.height, level) - y0);
+
+        for (int row = 0; row < rows; ++row) {
+            std::memcpy(&t.rgb[3 * row * tileSize], info.mipChain->row(level, y0 + row) + 3 * x0, 3 * columns);
+        }
+        return t;
+    }
+};
+
+#endif //RAYTRACER_TEXTURECACHE_H
@@ -0,0 +1,118 @@
+#ifndef RAYTRACER_TRANSFORM_H
+#define RAYTRACER_TRANSFORM_H
+
+#include <cmath>
+#include "AABB.h"
+#include "Vector3.h"
+
+// Affine transform stored as a 3x4 matrix (rotation/scale part + translation column)
+class Transform {
+public:
+    Transform() = default;   // identity
+
+    static Transform translation(const Vector3& offset) {
+        Transform t;
+        t.m_[0][3] = offset.x();
+        t.m_[1][3] = offset.y();
+        t.m_[2][3] = offset.z();
+        return t;
+    }
+
+    static Transform scaling(double sx, double sy, double sz) {
+        Transform t;
+        t.m_[0][0] = sx;
+        t.m_[1][1] = sy;
+        t.m_[2][2] = sz;
+        return t;
+    }
+
+    static Transform scaling(double s) { return scaling(s, s, s); }
+
+    // Rotation about the Y axis, same orientation as Camera::rotateYaw
+    static Transform rotationY(double angleDegrees) {
+        double angleRadians = degreesToRadians(angleDegrees);
+        double c = std::cos(angleRadians);
+        double s = std::sin(angleRadians);
+        Transform t;
+        t.m_[0][0] = c;  t.m_[0][2] = -s;
+        t.m_[2][0] = s;  t.m_[2][2] = c;
+        return t;
+    }
+
+    // Composition, (a * b) applies b first
+    Transform operator*(const Transform& other) const {
+        Transform result;
+        for (int row = 0; row < 3; ++row) {
+            for (int column = 0; column < 4; ++column) {
+                double value = (column == 3) ? m_[row][3] : 0.0;
+                for (int k = 0; k < 3; ++k) {
+                    value += m_[row][k] * other.m_[k][column];
+                }
+                result.m_[row][column] = value;
+            }
+        }
+        return result;
+    }
+
+    Transform inverse() const {
+        const auto& m = m_;
+        double c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+        double c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+        double c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+        double determinant = m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02;
+        double inverseDeterminant = 1.0 / determinant;
+
+        Transform result;
+        auto& r = result.m_;
+        r[0][0] = c00 * inverseDeterminant;
+        r[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * inverseDeterminant;
+        r[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * inverseDeterminant;
+        r[1][0] = c01 * inverseDeterminant;
+        r[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * inverseDeterminant;
+        r[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * inverseDeterminant;
+        r[2][0] = c02 * inverseDeterminant;
+        r[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * inverseDeterminant;
+        r[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * inverseDeterminant;
+
+        // Inverse translation = -R^-1 * t
+        for (int row = 0; row < 3; ++row) {
+            r[row][3] = -(r[row][0] * m[0][3] + r[row][1] * m[1][3] + r[row][2] * m[2][3]);
+        }
+        return result;
+    }
+
+    Point3 applyToPoint(const Point3& p) const {
+        return { m_[0][0] * p.x() + m_[0][1] * p.y() + m_[0][2] * p.z() + m_[0][3],
+                 m_[1][0] * p.x() + m_[1][1] * p.y() + m_[1][2] * p.z() + m_[1][3],
+                 m_[2][0] * p.x() + m_[2][1] * p.y() + m_[2][2] * p.z() + m_[2][3] };
+    }
+
+    Vector3 applyToVector(const Vector3& v) const {
+        return { m_[0][0] * v.x() + m_[0][1] * v.y() + m_[0][2] * v.z(),
+                 m_[1][0] * v.x() + m_[1][1] * v.y() + m_[1][2] * v.z(),
+                 m_[2][0] * v.x() + m_[2][1] * v.y() + m_[2][2] * v.z() };
+    }
+
+    // Multiplies by the transposed 3x3 part. Called on the inverse transform this maps normals.
+    Vector3 applyTransposeToVector(const Vector3& v) const {
+        return { m_[0][0] * v.x() + m_[1][0] * v.y() + m_[2][0] * v.z(),
+                 m_[0][1] * v.x() + m_[1][1] * v.y() + m_[2][1] * v.z(),
+                 m_[0][2] * v.x() + m_[1][2] * v.y() + m_[2][2] * v.z() };
+    }
+
+    AABB applyToBox(const AABB& box) const {
+        AABB result;
+        for (int corner = 0; corner < 8; ++corner) {
+            Point3 p((corner & 1) ? box.max().x() : box.min().x(),
+                     (corner & 2) ? box.max().y() : box.min().y(),
+                     (corner & 4) ? box.max().z() : box.min().z());
+            result.expand(applyToPoint(p));
+        }
+        return result;
+    }
+
+private:
+    double m_[3][4]{ { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 } };
+};
+
+#endif //RAYTRACER_TRANSFORM_H
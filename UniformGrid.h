@@ -0,0 +1,356 @@
+#ifndef RAYTRACER_UNIFORMGRID_H
+#define RAYTRACER_UNIFORMGRID_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "AABB.h"
+#include "Scene.h"
+
+// Slot index plus the generation it was issued for, so a handle to a removed object stays invalid
+// after its slot is reused
+struct GridHandle {
+    uint32_t index{ UINT32_MAX };
+    uint32_t generation{ 0 };
+
+    bool operator==(const GridHandle& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const GridHandle& other) const { return !(*this == other); }
+};
+
+// Hashed uniform grid for scenes where objects move every frame.
+// Only occupied cells are stored, so the grid is unbounded and costs memory per object, not per volume.
+// insert(), remove() and move() only touch the cells the object overlaps, which is O(1) as long as
+// objects are not much larger than cellSize; there is nothing to rebuild between frames.
+// Rays walk the cells with a 3D-DDA and stop at the first cell that contains the closest hit.
+// Stale or invalid handles are ignored. The grid is an Object: add it to a Scene to render it.
+// Objects must stay alive while they are in the grid. Not safe to trace from several threads at once
+// (rayHit uses a shared mailbox to skip objects that span several cells).
+class UniformGrid : public Object {
+public:
+    static constexpr GridHandle invalidHandle{};
+
+    explicit UniformGrid(double cellSize = 1.0) : cellSize_(cellSize), inverseCellSize_(1.0 / cellSize) {}
+
+    GridHandle insert(Object* object) {
+        uint32_t index;
+        if (!freeSlots_.empty()) {
+            index = freeSlots_.back();
+            freeSlots_.pop_back();
+        }
+        else {
+            index = static_cast<uint32_t>(slots_.size());
+            slots_.emplace_back();
+            mailbox_.push_back(0);
+        }
+
+        Slot& slot = slots_[index];
+        slot.object = object;
+        slot.alive = true;
+        addToCells(index);
+        ++size_;
+        return GridHandle{ index, slot.generation };
+    }
+
+    // Returns false for a stale or invalid handle
+    bool remove(GridHandle handle) {
+        if (!contains(handle)) return false;
+
+        Slot& slot = slots_[handle.index];
+        removeFromCells(handle.index);
+        slot.object = nullptr;
+        slot.alive = false;
+        ++slot.generation;
+        freeSlots_.push_back(handle.index);
+        --size_;
+        return true;
+    }
+
+    // Translates the object in place and re-bins it. Returns false for stale handles and objects that can't be moved.
+    bool move(GridHandle handle, const Vector3& offset) {
+        if (!contains(handle) || !slots_[handle.index].object->translate(offset)) return false;
+
+        update(handle);
+        return true;
+    }
+
+    // Re-bins an object the caller has changed directly
+    void update(GridHandle handle) {
+        if (!contains(handle)) return;
+        removeFromCells(handle.index);
+        addToCells(handle.index);
+    }
+
+    bool contains(GridHandle handle) const {
+        return handle.index < slots_.size() && slots_[handle.index].alive && slots_[handle.index].generation == handle.generation;
+    }
+
+    // Empties the grid, handles issued before stay invalid
+    void clear() {
+        for (uint32_t index = 0; index < slots_.size(); ++index) {
+            Slot& slot = slots_[index];
+            if (slot.alive) {
+                slot.object = nullptr;
+                slot.alive = false;
+                slot.unbounded = false;
+                slot.entries.clear();
+                ++slot.generation;
+                freeSlots_.push_back(index);
+            }
+        }
+        cells_.clear();
+        unbounded_.clear();
+        occupiedCells_ = CellRange{};
+        occupiedCellsStale_ = false;
+        size_ = 0;
+    }
+
+    size_t size() const { return size_; }
+    double cellSize() const { return cellSize_; }
+
+    std::optional<HitRecord> rayHit(const Ray& ray, Interval rayInterval) const override {
+        HitRecord closestHit;
+        bool hitAnything = false;
+        double closestSoFar = rayInterval.max();
+        uint32_t rayId = ++rayCounter_;
+        if (rayId == 0) {
+            // Counter wrapped, old stamps could collide with new ids
+            std::fill(mailbox_.begin(), mailbox_.end(), 0);
+            rayId = ++rayCounter_;
+        }
+
+        auto testObject = [&](uint32_t index) {
+            if (mailbox_[index] == rayId) return;   // already tested from another cell
+            mailbox_[index] = rayId;
+
+            if (auto hit = slots_[index].object->rayHit(ray, Interval(rayInterval.min(), closestSoFar))) {
+                hitAnything = true;
+                closestSoFar = hit->distanceAlongRay();
+                closestHit = *hit;
+            }
+        };
+
+        for (uint32_t index : unbounded_) testObject(index);
+
+        if (occupiedCellsStale_) shrinkOccupiedCells();
+        if (!occupiedCells_.isEmpty()) {
+            AABB gridBounds(Point3(occupiedCells_.x0, occupiedCells_.y0, occupiedCells_.z0) * cellSize_,
+                            Point3(occupiedCells_.x1 + 1, occupiedCells_.y1 + 1, occupiedCells_.z1 + 1) * cellSize_);
+
+            if (auto overlap = gridBounds.rayOverlap(ray, Interval(rayInterval.min(), closestSoFar))) {
+                walkCells(ray, *overlap, closestSoFar, testObject);
+            }
+        }
+
+        return hitAnything ? std::optional<HitRecord>{closestHit} : std::nullopt;
+    }
+
+    std::optional<AABB> boundingBox() const override {
+        if (!unbounded_.empty()) return std::nullopt;
+
+        AABB bounds;
+        for (const auto& slot : slots_) {
+            if (slot.alive) bounds.expand(*slot.object->boundingBox());
+        }
+        return bounds;
+    }
+
+private:
+    struct CellRange {
+        int x0{ 1 }, y0{ 1 }, z0{ 1 };
+        int x1{ 0 }, y1{ 0 }, z1{ 0 };
+
+        bool isEmpty() const { return x0 > x1; }
+
+        void expand(const CellRange& other) {
+            if (isEmpty()) { *this = other; return; }
+            x0 = std::min(x0, other.x0); y0 = std::min(y0, other.y0); z0 = std::min(z0, other.z0);
+            x1 = std::max(x1, other.x1); y1 = std::max(y1, other.y1); z1 = std::max(z1, other.z1);
+        }
+
+        bool onBoundary(int x, int y, int z) const {
+            return x == x0 || x == x1 || y == y0 || y == y1 || z == z0 || z == z1;
+        }
+    };
+
+    // Where an object sits inside one cell's list, so removal can swap-erase without searching
+    struct CellEntry {
+        uint64_t cellKey;
+        uint32_t index;
+    };
+
+    struct Slot {
+        Object* object{ nullptr };
+        std::vector<CellEntry> entries;   // one per overlapped cell
+        uint32_t generation{ 0 };         // bumped on removal
+        bool alive{ false };
+        bool unbounded{ false };
+    };
+
+    static constexpr int cellCoordinateBits = 21;
+    static constexpr int cellCoordinateLimit = (1 << (cellCoordinateBits - 1)) - 1;
+
+    double cellSize_;
+    double inverseCellSize_;
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> freeSlots_;
+    std::vector<uint32_t> unbounded_;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> cells_;   // slot indices per occupied cell
+    // Cell range the DDA walks. Inserts grow it right away; when a cell on its boundary empties it is
+    // marked stale and recomputed from the occupied cells before the next ray, once per batch of edits.
+    mutable CellRange occupiedCells_;
+    mutable bool occupiedCellsStale_{ false };
+    size_t size_{ 0 };
+
+    mutable std::vector<uint32_t> mailbox_;   // last ray id that tested each slot
+    mutable uint32_t rayCounter_{ 0 };
+
+    int cellCoordinate(double value) const {
+        double cell = std::floor(value * inverseCellSize_);
+        return static_cast<int>(std::clamp(cell, double(-cellCoordinateLimit), double(cellCoordinateLimit)));
+    }
+
+    static uint64_t cellKey(int x, int y, int z) {
+        const uint64_t mask = (uint64_t(1) << cellCoordinateBits) - 1;
+        return ((uint64_t(x + cellCoordinateLimit) & mask) << (2 * cellCoordinateBits))
+             | ((uint64_t(y + cellCoordinateLimit) & mask) << cellCoordinateBits)
+             | (uint64_t(z + cellCoordinateLimit) & mask);
+    }
+
+    static void cellCoordinates(uint64_t key, int& x, int& y, int& z) {
+        const uint64_t mask = (uint64_t(1) << cellCoordinateBits) - 1;
+        x = static_cast<int>((key >> (2 * cellCoordinateBits)) & mask) - cellCoordinateLimit;
+        y = static_cast<int>((key >> cellCoordinateBits) & mask) - cellCoordinateLimit;
+        z = static_cast<int>(key & mask) - cellCoordinateLimit;
+    }
+
+    void shrinkOccupiedCells() const {
+        occupiedCells_ = CellRange{};
+        for (const auto& cell : cells_) {
+            CellRange single;
+            cellCoordinates(cell.first, single.x0, single.y0, single.z0);
+            single.x1 = single.x0; single.y1 = single.y0; single.z1 = single.z0;
+            occupiedCells_.expand(single);
+        }
+        occupiedCellsStale_ = false;
+    }
+
+    void addToCells(uint32_t index) {
+        Slot& slot = slots_[index];
+        auto bounds = slot.object->boundingBox();
+        if (!bounds) {
+            slot.unbounded = true;
+            unbounded_.push_back(index);
+            return;
+        }
+
+        CellRange range;
+        range.x0 = cellCoordinate(bounds->min().x()); range.x1 = cellCoordinate(bounds->max().x());
+        range.y0 = cellCoordinate(bounds->min().y()); range.y1 = cellCoordinate(bounds->max().y());
+        range.z0 = cellCoordinate(bounds->min().z()); range.z1 = cellCoordinate(bounds->max().z());
+        occupiedCells_.expand(range);
+
+        slot.entries.clear();
+        for (int z = range.z0; z <= range.z1; ++z) {
+            for (int y = range.y0; y <= range.y1; ++y) {
+                for (int x = range.x0; x <= range.x1; ++x) {
+                    uint64_t key = cellKey(x, y, z);
+                    auto& cell = cells_[key];
+                    slot.entries.push_back(CellEntry{ key, static_cast<uint32_t>(cell.size()) });
+                    cell.push_back(index);
+                }
+            }
+        }
+    }
+
+    void removeFromCells(uint32_t index) {
+        Slot& slot = slots_[index];
+        if (slot.unbounded) {
+            unbounded_.erase(std::find(unbounded_.begin(), unbounded_.end(), index));
+            slot.unbounded = false;
+            return;
+        }
+
+        for (const CellEntry& entry : slot.entries) {
+            auto found = cells_.find(entry.cellKey);
+            auto& cell = found->second;
+
+            // Swap-erase, then fix up the bookkeeping of the object that took our place
+            uint32_t moved = cell.back();
+            cell[entry.index] = moved;
+            cell.pop_back();
+            if (moved != index) {
+                for (CellEntry& movedEntry : slots_[moved].entries) {
+                    if (movedEntry.cellKey == entry.cellKey) {
+                        movedEntry.index = entry.index;
+                        break;
+                    }
+                }
+            }
+
+            if (cell.empty()) {
+                int x, y, z;
+                cellCoordinates(entry.cellKey, x, y, z);
+                if (occupiedCells_.onBoundary(x, y, z)) occupiedCellsStale_ = true;
+                cells_.erase(found);
+            }
+        }
+        slot.entries.clear();
+    }
+
+    // 3D-DDA over the cells the ray crosses inside [overlap.min, overlap.max]
+    template <typename TestObject>
+    void walkCells(const Ray& ray, Interval overlap, const double& closestSoFar, TestObject& testObject) const {
+        Point3 start = ray.at(overlap.min());
+        Vector3 direction = ray.direction();
+
+        int cell[3] = { cellCoordinate(start.x()), cellCoordinate(start.y()), cellCoordinate(start.z()) };
+        const int lower[3] = { occupiedCells_.x0, occupiedCells_.y0, occupiedCells_.z0 };
+        const int upper[3] = { occupiedCells_.x1, occupiedCells_.y1, occupiedCells_.z1 };
+        const double origin[3] = { ray.origin().x(), ray.origin().y(), ray.origin().z() };
+        const double dir[3] = { direction.x(), direction.y(), direction.z() };
+
+        int step[3];
+        double tNext[3];    // ray parameter where the next cell boundary on each axis is crossed
+        double tDelta[3];   // ray parameter between boundaries on each axis
+        for (int axis = 0; axis < 3; ++axis) {
+            cell[axis] = std::clamp(cell[axis], lower[axis], upper[axis]);   // start point may sit on the far face
+
+            if (dir[axis] > 0.0) {
+                step[axis] = 1;
+                tNext[axis] = ((cell[axis] + 1) * cellSize_ - origin[axis]) / dir[axis];
+                tDelta[axis] = cellSize_ / dir[axis];
+            }
+            else if (dir[axis] < 0.0) {
+                step[axis] = -1;
+                tNext[axis] = (cell[axis] * cellSize_ - origin[axis]) / dir[axis];
+                tDelta[axis] = -cellSize_ / dir[axis];
+            }
+            else {
+                step[axis] = 0;
+                tNext[axis] = infinity;
+                tDelta[axis] = infinity;
+            }
+        }
+
+        while (true) {
+            auto found = cells_.find(cellKey(cell[0], cell[1], cell[2]));
+            if (found != cells_.end()) {
+                for (uint32_t index : found->second) testObject(index);
+            }
+
+            int axis = (tNext[0] < tNext[1]) ? (tNext[0] < tNext[2] ? 0 : 2) : (tNext[1] < tNext[2] ? 1 : 2);
+            double cellExit = tNext[axis];
+
+            // A hit inside this cell can't be beaten by anything further along
+            if (closestSoFar <= cellExit || cellExit > overlap.max()) return;
+
+            cell[axis] += step[axis];
+            if (cell[axis] < lower[axis] || cell[axis] > upper[axis]) return;
+            tNext[axis] += tDelta[axis];
+        }
+    }
+};
+
+#endif //RAYTRACER_UNIFORMGRID_H
@@ -1,13 +1,84 @@
 #include <SDL.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <vector>
 #include "Camera.h"
+#include "FrameGovernor.h"
+#include "ImageTextureMaterial.h"
+#include "Instance.h"
 #include "Scene.h"
 #include "Renderer.h"
+#include "RenderServer.h"
+#include "TextureCache.h"
 
 const int WINDOW_WIDTH = 800;
 const int WINDOW_HEIGHT = 600;
+const Uint32 IDLE_BEFORE_FULL_FRAME_MS = 150;   // how long input must stop before going back to full resolution
 
 int main(int argc, char* argv[]) {
+    double frameBudgetMs = 16.0;
+    const char* floorTexturePath = nullptr;
+    size_t textureCacheMegabytes = 64;
+    int instanceCount = 0;
+    int reflectionDepth = 0;
+    int lightCount = 0;
+    bool sortSecondaryRays = true;
+    bool batchShadowRays = false;
+    bool perPixelReflections = false;
+    RendererParameters rendererParameters = RendererParameters::defaultParameters();
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--frame-budget") == 0 && i + 1 < argc) {
+            frameBudgetMs = std::atof(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--floor-texture") == 0 && i + 1 < argc) {
+            floorTexturePath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--texture-cache-mb") == 0 && i + 1 < argc) {
+            textureCacheMegabytes = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+            instanceCount = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--reflections") == 0 && i + 1 < argc) {
+            reflectionDepth = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--lights") == 0 && i + 1 < argc) {
+            lightCount = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--no-ray-sort") == 0) {
+            sortSecondaryRays = false;
+        }
+        else if (std::strcmp(argv[i], "--batch-shadows") == 0) {
+            batchShadowRays = true;
+        }
+        else if (std::strcmp(argv[i], "--per-pixel-reflections") == 0) {
+            perPixelReflections = true;
+        }
+        else if (std::strcmp(argv[i], "--no-aa") == 0) {
+            rendererParameters.setAntiAliasing(false);
+        }
+        else if (std::strcmp(argv[i], "--no-shadows") == 0) {
+            rendererParameters.setShadows(false);
+        }
+        else if (std::strcmp(argv[i], "--no-floor") == 0) {
+            rendererParameters.setFloorPlane(false);
+        }
+        else if (std::strcmp(argv[i], "--linear") == 0) {
+            rendererParameters.setGammaMode(GammaMode::Linear);
+        }
+        else if (std::strcmp(argv[i], "--exact") == 0) {
+            rendererParameters.setExactMath(true);
+        }
+        else if (std::strcmp(argv[i], "--server") == 0 && i + 1 < argc) {
+            // Headless daemon mode, no window
+            RenderServer server(argv[++i]);
+            return server.run();
+        }
+    }
+
     if (SDL_Init(SDL_INIT_VIDEO) != 0) {
         std::cerr << "SDL_Init Error: " << SDL_GetError() << std::endl;
         return 1;
@@ -46,6 +117,7 @@ int main(int argc, char* argv[]) {
 
     // Allocate pixel buffer (ARGB format)
     uint32_t* pixels = new uint32_t[WINDOW_WIDTH * WINDOW_HEIGHT];
+    std::vector<uint32_t> reducedPixels(WINDOW_WIDTH * WINDOW_HEIGHT);   // internal frame while the camera moves
 
     // Setup raytracing scene, camera, renderer
     Camera camera(
@@ -61,45 +133,123 @@ int main(int argc, char* argv[]) {
     scene.add(cone);
     //Plane* ground = new Plane(Point3(0, -0.5, 0), Vector3(0, 1, 0));
     //scene.add(ground);
+
+    // Optional crowd of copies of one small sphere + cone cluster, all sharing the same geometry
+    Sphere clusterSphere(Point3(-0.6, 0.0, 0.0), 0.5);
+    Cone clusterCone(Point3(0.6, 0.0, 0.0), 2.0, 0.5);
+    Scene cluster;
+    cluster.add(&clusterSphere);
+    cluster.add(&clusterCone);
+    InstanceGroup crowd;
+    if (instanceCount > 0) {
+        int side = static_cast<int>(std::ceil(std::sqrt(double(instanceCount))));
+        for (int i = 0; i < instanceCount; ++i) {
+            double x = (i % side - side / 2) * 0.6;
+            double z = -4.0 - (i / side) * 0.6;
+            crowd.add(&cluster, Transform::translation(Vector3(x, -0.4, z)) * Transform::rotationY(i * 37.0) * Transform::scaling(0.15));
+        }
+        crowd.build();
+        scene.add(&crowd);
+    }
+    // Optional field of small point and sphere lights, total power kept constant so brightness doesn't depend on the count
+    std::vector<std::unique_ptr<Light>> lights;
+    for (int i = 0; i < lightCount; ++i) {
+        Point3 position(Random::randomDouble(-4, 4), Random::randomDouble(0.5, 4), Random::randomDouble(-6, 1));
+        Color3 intensity = (40.0 / lightCount) * Vector3::randomInRange(0.5, 1.0);
+        if (i % 2 == 0) lights.push_back(std::make_unique<PointLight>(position, intensity));
+        else lights.push_back(std::make_unique<SphereLight>(position, 0.1, intensity));
+        scene.addLight(lights.back().get());
+    }
+
     Renderer raytracer(scene, camera);
+    if (reflectionDepth > RendererParameters::maximumReflectionDepth) {
+        std::cerr << "--reflections " << reflectionDepth << " is above the maximum, using " << RendererParameters::maximumReflectionDepth << "\n";
+    }
+    rendererParameters.setReflectionDepth(reflectionDepth)
+        .setBreadthFirstReflections(!perPixelReflections)
+        .setSortSecondaryRays(sortSecondaryRays)
+        .setBatchShadowRays(batchShadowRays);
+    raytracer.setParameters(rendererParameters);
+
+    TextureCache textureCache(textureCacheMegabytes << 20);
+    std::unique_ptr<ImageTextureMaterial> floorMaterial;
+    if (floorTexturePath != nullptr) {
+        int floorTexture = textureCache.addTexture(floorTexturePath);
+        if (floorTexture >= 0) {
+            floorMaterial = std::make_unique<ImageTextureMaterial>(textureCache, floorTexture, 0.25, camera.pixelSpreadAngle());
+            raytracer.setFloorMaterial(floorMaterial.get());
+        }
+    }
+
+    FrameGovernor governor(WINDOW_WIDTH, WINDOW_HEIGHT);
+    governor.setBudgetMs(frameBudgetMs);
+
+    auto trace = [&](uint32_t* target, int width, int height, int samplesPerPixel) {
+        raytracer.render(scene, camera, target, width, height, samplesPerPixel);
+    };
 
-    raytracer.render(scene, camera, pixels, WINDOW_WIDTH, WINDOW_HEIGHT);
+    // Renders one frame at the governor's chosen scale and uploads it to the texture
+    auto renderFrame = [&](const FrameScale& frame) {
+        auto start = std::chrono::steady_clock::now();
 
-    SDL_UpdateTexture(texture, nullptr, pixels, WINDOW_WIDTH * sizeof(uint32_t));
+        if (frame.fullResolution) {
+            trace(pixels, WINDOW_WIDTH, WINDOW_HEIGHT, frame.samplesPerPixel);
+        }
+        else {
+            trace(reducedPixels.data(), frame.width, frame.height, frame.samplesPerPixel);
+            upscaleNearest(reducedPixels.data(), frame.width, frame.height, pixels, WINDOW_WIDTH, WINDOW_HEIGHT);
+        }
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        governor.recordFrame(frame, elapsed.count());
+        if (floorMaterial) std::cout << textureCache.stats() << "\n";
+
+        SDL_UpdateTexture(texture, nullptr, pixels, WINDOW_WIDTH * sizeof(uint32_t));
+    };
+
+    renderFrame(governor.fullFrame());
 
     bool running = true;
+    bool cameraMoved = false;     // camera changed since the last frame
+    bool needsFullFrame = false;  // last frame shown was a reduced one
+    Uint32 lastInputTicks = 0;
     SDL_Event event;
     while (running) {
+        // Drain all pending events first so held keys don't queue up frames
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT) {
                 running = false;
             }
             else if (event.type == SDL_KEYDOWN) {
-                bool rerender = false;
-
                 if (event.key.keysym.sym == SDLK_LEFT) {
                     camera.rotateYaw(-10);  // Rotate left
-                    rerender = true;
+                    cameraMoved = true;
                 }
                 else if (event.key.keysym.sym == SDLK_RIGHT) {
                     camera.rotateYaw(10);   // Rotate right
-                    rerender = true;
+                    cameraMoved = true;
                 }
 
-                if (rerender) {
-                    raytracer.render(scene, camera, pixels, WINDOW_WIDTH, WINDOW_HEIGHT);
-                    SDL_UpdateTexture(texture, nullptr, pixels, WINDOW_WIDTH * sizeof(uint32_t));
-                }
+                if (cameraMoved) lastInputTicks = SDL_GetTicks();
             }
         }
 
+        if (cameraMoved) {
+            renderFrame(governor.interactiveFrame());
+            cameraMoved = false;
+            needsFullFrame = true;
+        }
+        else if (needsFullFrame && SDL_GetTicks() - lastInputTicks > IDLE_BEFORE_FULL_FRAME_MS) {
+            renderFrame(governor.fullFrame());
+            needsFullFrame = false;
+        }
+
         SDL_RenderClear(renderer);
         SDL_RenderCopy(renderer, texture, nullptr, nullptr);
         SDL_RenderPresent(renderer);
         SDL_Delay(16);
     }
 
-
     delete[] pixels;
     SDL_DestroyTexture(texture);
     SDL_DestroyRenderer(renderer);
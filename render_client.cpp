@@ -0,0 +1,119 @@
+// Test client for the render server: loads a scene file and renders a turntable
+// (yaw steps around the look-at point), writing each frame as a PPM.
+//
+//   ./render_client <socket> <scene file> [frames] [width] [height] [spp]
+//   ./render_client <socket> --shutdown
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "RenderProtocol.h"
+
+static bool writePPM(const std::string& fileName, const std::vector<uint32_t>& pixels, int width, int height) {
+    std::ofstream out(fileName, std::ios::binary);
+    if (!out) return false;
+
+    out << "P6\n" << width << " " << height << "\n255\n";
+    for (uint32_t argb : pixels) {
+        char rgb[3] = { char((argb >> 16) & 0xff), char((argb >> 8) & 0xff), char(argb & 0xff) };
+        out.write(rgb, 3);
+    }
+    return bool(out);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " <socket> <scene file> [frames] [width] [height] [spp]\n";
+        return 1;
+    }
+
+    std::string socketPath = argv[1];
+    std::string scenePath = argv[2];
+
+    if (scenePath == "--shutdown") {
+        int fd = RenderProtocol::connectTo(socketPath);
+        std::string reply;
+        if (fd < 0 || !RenderProtocol::writeLine(fd, "SHUTDOWN") || !RenderProtocol::readLine(fd, reply)) {
+            std::cerr << "Cannot reach " << socketPath << "\n";
+            return 1;
+        }
+        ::close(fd);
+        return 0;
+    }
+
+    int frames = argc > 3 ? std::atoi(argv[3]) : 8;
+    int width = argc > 4 ? std::atoi(argv[4]) : 320;
+    int height = argc > 5 ? std::atoi(argv[5]) : 240;
+    int samplesPerPixel = argc > 6 ? std::atoi(argv[6]) : 4;
+
+    std::ifstream sceneFile(scenePath);
+    if (!sceneFile) {
+        std::cerr << "Cannot read " << scenePath << "\n";
+        return 1;
+    }
+    std::stringstream sceneText;
+    sceneText << sceneFile.rdbuf();
+    std::string scene = sceneText.str();
+
+    int fd = RenderProtocol::connectTo(socketPath);
+    if (fd < 0) {
+        std::cerr << "Cannot connect to " << socketPath << "\n";
+        return 1;
+    }
+
+    std::string reply;
+    RenderProtocol::writeLine(fd, "LOAD turntable " + std::to_string(scene.size()));
+    RenderProtocol::writeAll(fd, scene.data(), scene.size());
+    if (!RenderProtocol::readLine(fd, reply) || reply.compare(0, 2, "OK") != 0) {
+        std::cerr << "LOAD failed: " << reply << "\n";
+        return 1;
+    }
+    std::cout << "Loaded: " << reply << "\n";
+
+    std::vector<uint32_t> pixels;
+    for (int frame = 0; frame < frames; ++frame) {
+        double yaw = 360.0 * frame / frames;
+        std::ostringstream request;
+        request << "RENDER turntable 0 0 0.3 0 0 -1 " << yaw << " " << width << " " << height << " " << samplesPerPixel;
+
+        auto start = std::chrono::steady_clock::now();
+        RenderProtocol::writeLine(fd, request.str());
+        if (!RenderProtocol::readLine(fd, reply)) {
+            std::cerr << "Server closed the connection\n";
+            return 1;
+        }
+
+        std::istringstream header(reply);
+        std::string status;
+        int replyWidth = 0, replyHeight = 0;
+        long traceMicroseconds = 0;
+        header >> status >> replyWidth >> replyHeight >> traceMicroseconds;
+        if (status != "OK") {
+            std::cerr << "RENDER failed: " << reply << "\n";
+            return 1;
+        }
+
+        pixels.resize(size_t(replyWidth) * replyHeight);
+        if (!RenderProtocol::readExact(fd, pixels.data(), pixels.size() * sizeof(uint32_t))) {
+            std::cerr << "Short pixel payload\n";
+            return 1;
+        }
+        std::chrono::duration<double, std::milli> roundTrip = std::chrono::steady_clock::now() - start;
+
+        char fileName[64];
+        std::snprintf(fileName, sizeof(fileName), "frame_%03d.ppm", frame);
+        writePPM(fileName, pixels, replyWidth, replyHeight);
+
+        std::cout << fileName << ": trace " << traceMicroseconds / 1000.0 << " ms, round trip " << roundTrip.count() << " ms\n";
+    }
+
+    RenderProtocol::writeLine(fd, "UNLOAD turntable");
+    RenderProtocol::readLine(fd, reply);
+    ::close(fd);
+    return 0;
+}